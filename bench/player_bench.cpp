@@ -0,0 +1,210 @@
+// times player::update() across voice counts, voice types, output formats
+// and frame counts, reporting ns per frame and the realtime headroom factor
+// (how many times faster than realtime the block was rendered).
+// --quick runs a reduced set, and --limiter turns the master limiter on
+#include <player.hpp>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+constexpr static const unsigned int bench_sample_rate = 44100;
+constexpr static const size_t bench_wav_frames = 4096;
+// minimum time spent on each case
+constexpr static const double bench_min_seconds = .02;
+
+typedef enum {
+    BENCH_SIN = 0,
+    BENCH_SQR,
+    BENCH_SAW,
+    BENCH_TRI,
+    BENCH_WAV
+} bench_voice_t;
+static const char* bench_voice_names[] = {"sin","sqr","saw","tri","wav"};
+
+// each wav voice gets its own cursor into a shared in memory mono wav
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+} bench_stream_t;
+
+static uint8_t* bench_wav_data = nullptr;
+static size_t bench_wav_size = 0;
+static bench_stream_t* bench_streams = nullptr;
+static volatile uint32_t bench_sink = 0;
+
+static void bench_put16(uint8_t*& p, uint16_t value) {
+    *p++=value&0xFF;
+    *p++=(value>>8)&0xFF;
+}
+static void bench_put32(uint8_t*& p, uint32_t value) {
+    bench_put16(p,value&0xFFFF);
+    bench_put16(p,(value>>16)&0xFFFF);
+}
+static bool bench_make_wav() {
+    const size_t data_size = bench_wav_frames*2;
+    bench_wav_size = 44+data_size;
+    bench_wav_data = (uint8_t*)malloc(bench_wav_size);
+    if(bench_wav_data==nullptr) {
+        return false;
+    }
+    uint8_t* p = bench_wav_data;
+    memcpy(p,"RIFF",4);p+=4;
+    bench_put32(p,(uint32_t)(bench_wav_size-8));
+    memcpy(p,"WAVEfmt ",8);p+=8;
+    bench_put32(p,16);
+    bench_put16(p,1); // PCM
+    bench_put16(p,1); // mono
+    bench_put32(p,bench_sample_rate);
+    bench_put32(p,bench_sample_rate*2);
+    bench_put16(p,2);
+    bench_put16(p,16);
+    memcpy(p,"data",4);p+=4;
+    bench_put32(p,(uint32_t)data_size);
+    uint32_t seed = 0x12345678;
+    for(size_t i = 0;i<bench_wav_frames;++i) {
+        seed = seed*1664525U+1013904223U;
+        bench_put16(p,(uint16_t)(seed>>16));
+    }
+    return true;
+}
+static int bench_read(void* state) {
+    bench_stream_t* s = (bench_stream_t*)state;
+    if(s->pos>=s->size) {
+        return -1;
+    }
+    return s->data[s->pos++];
+}
+static void bench_seek(unsigned long long pos, void* state) {
+    ((bench_stream_t*)state)->pos = (size_t)pos;
+}
+static void bench_flush(const void* buffer, size_t buffer_size, void* state) {
+    (void)state;
+    // touch the output so the work can't be optimized away
+    bench_sink+=((const uint8_t*)buffer)[buffer_size-1];
+}
+static bool bench_add_voice(player& p, bench_voice_t type, size_t index) {
+    const unsigned short port = (unsigned short)(index&3);
+    const float frequency = 110.0f+index*7.0f;
+    const float amplitude = .8f/(index+1);
+    voice_handle_t handle = nullptr;
+    switch(type) {
+        case BENCH_SIN:
+            handle = p.sin(port,frequency,amplitude);
+            break;
+        case BENCH_SQR:
+            handle = p.sqr(port,frequency,amplitude);
+            break;
+        case BENCH_SAW:
+            handle = p.saw(port,frequency,amplitude);
+            break;
+        case BENCH_TRI:
+            handle = p.tri(port,frequency,amplitude);
+            break;
+        case BENCH_WAV: {
+            bench_stream_t* s = bench_streams+index;
+            s->data = bench_wav_data;
+            s->size = bench_wav_size;
+            s->pos = 0;
+            handle = p.wav(port,bench_read,s,amplitude,true,bench_seek,s);
+        }
+        break;
+    }
+    return handle!=nullptr;
+}
+// returns the seconds per update(), or a negative value on failure
+static double bench_run(bench_voice_t type, 
+                        size_t voices, 
+                        unsigned short channels, 
+                        unsigned short bit_depth, 
+                        size_t frame_count,
+                        bool limiter) {
+    player p(bench_sample_rate,channels,bit_depth,frame_count);
+    p.on_flush(bench_flush);
+    if(!p.initialize() || !p.limiter(limiter)) {
+        return -1.0;
+    }
+    for(size_t i = 0;i<voices;++i) {
+        if(!bench_add_voice(p,type,i)) {
+            return -1.0;
+        }
+    }
+    // warm up
+    for(int i = 0;i<4;++i) {
+        p.update();
+    }
+    typedef std::chrono::steady_clock clock;
+    size_t iterations = 0;
+    double elapsed = 0.0;
+    clock::time_point start = clock::now();
+    while(elapsed<bench_min_seconds || iterations<8) {
+        for(int i = 0;i<8;++i) {
+            p.update();
+        }
+        iterations+=8;
+        elapsed = std::chrono::duration<double>(clock::now()-start).count();
+    }
+    return elapsed/iterations;
+}
+int main(int argc, char** argv) {
+    bool quick = false;
+    bool limiter = false;
+    for(int i = 1;i<argc;++i) {
+        if(0==strcmp(argv[i],"--quick")) {
+            quick = true;
+        } else if(0==strcmp(argv[i],"--limiter")) {
+            limiter = true;
+        }
+    }
+    static const size_t voice_counts[] = {1,4,16,64,256};
+    static const size_t quick_voice_counts[] = {1,16};
+    static const size_t frame_counts[] = {64,256,1024};
+    static const size_t quick_frame_counts[] = {256};
+    static const unsigned short formats[][2] = {{1,8},{2,8},{1,16},{2,16}};
+    const size_t* vc = quick?quick_voice_counts:voice_counts;
+    const size_t vc_len = quick?sizeof(quick_voice_counts)/sizeof(size_t):sizeof(voice_counts)/sizeof(size_t);
+    const size_t* fc = quick?quick_frame_counts:frame_counts;
+    const size_t fc_len = quick?sizeof(quick_frame_counts)/sizeof(size_t):sizeof(frame_counts)/sizeof(size_t);
+    if(!bench_make_wav()) {
+        fprintf(stderr,"out of memory\n");
+        return 1;
+    }
+    bench_streams = (bench_stream_t*)malloc(sizeof(bench_stream_t)*voice_counts[4]);
+    if(bench_streams==nullptr) {
+        fprintf(stderr,"out of memory\n");
+        return 1;
+    }
+    printf("%-5s %6s %4s %4s %6s %12s %12s %12s\n",
+        "voice","voices","ch","bits","frames","us/update","ns/frame","realtime x");
+    int result = 0;
+    for(int t = BENCH_SIN;t<=BENCH_WAV;++t) {
+        for(size_t f = 0;f<sizeof(formats)/sizeof(formats[0]);++f) {
+            for(size_t c = 0;c<vc_len;++c) {
+                for(size_t n = 0;n<fc_len;++n) {
+                    const double seconds = bench_run((bench_voice_t)t,vc[c],formats[f][0],formats[f][1],fc[n],limiter);
+                    if(seconds<0.0) {
+                        printf("%-5s %6zu %4u %4u %6zu %12s\n",
+                            bench_voice_names[t],vc[c],formats[f][0],formats[f][1],fc[n],"failed");
+                        result = 1;
+                        continue;
+                    }
+                    const double block_seconds = (double)fc[n]/bench_sample_rate;
+                    printf("%-5s %6zu %4u %4u %6zu %12.2f %12.2f %12.1f\n",
+                        bench_voice_names[t],
+                        vc[c],
+                        formats[f][0],
+                        formats[f][1],
+                        fc[n],
+                        seconds*1e6,
+                        seconds*1e9/fc[n],
+                        block_seconds/seconds);
+                }
+            }
+        }
+    }
+    free(bench_streams);
+    free(bench_wav_data);
+    return result;
+}
@@ -2,8 +2,104 @@
 #include <Arduino.h>
 #else
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #endif
+// the alignment of the player's buffers, in bytes. each buffer is also
+// padded out to a multiple of this. caller provided output buffers must
+// be aligned to it. define it before including to change it
+#ifndef PLAYER_BUFFER_ALIGNMENT
+#if defined(ARDUINO_ARCH_ESP32)
+#define PLAYER_BUFFER_ALIGNMENT 32
+#elif defined(ARDUINO)
+#define PLAYER_BUFFER_ALIGNMENT 4
+#else
+#define PLAYER_BUFFER_ALIGNMENT 64
+#endif
+#endif
+// the sample format of the output buffer
+typedef enum {
+    // unsigned 8-bit, centered on 128
+    PLAYER_FORMAT_U8 = 0,
+    // unsigned 16-bit, centered on 32768
+    PLAYER_FORMAT_U16,
+    // signed 16-bit
+    PLAYER_FORMAT_S16,
+    // signed 24-bit in the low bits of a sign extended 32-bit word
+    PLAYER_FORMAT_S24_32,
+    // signed 32-bit
+    PLAYER_FORMAT_S32,
+    // 32-bit float, from -1 to 1
+    PLAYER_FORMAT_F32
+} player_format_t;
+// the number of biquad stages in each filter chain
+#define PLAYER_FILTER_STAGES 4
+// the kind of a filter stage
+typedef enum {
+    // the stage is off
+    PLAYER_FILTER_NONE = 0,
+    PLAYER_FILTER_LOWPASS,
+    PLAYER_FILTER_HIGHPASS,
+    PLAYER_FILTER_BANDPASS,
+    // boosts or cuts below the frequency by the gain
+    PLAYER_FILTER_LOWSHELF,
+    // boosts or cuts above the frequency by the gain
+    PLAYER_FILTER_HIGHSHELF,
+    // boosts or cuts around the frequency by the gain
+    PLAYER_FILTER_PEAK
+} player_filter_t;
+// the waveform of a built in oscillator
+typedef enum {
+    PLAYER_WAVEFORM_SIN = 0,
+    PLAYER_WAVEFORM_SQR,
+    PLAYER_WAVEFORM_SAW,
+    PLAYER_WAVEFORM_TRI
+} player_waveform_t;
+// a note in a sequence. times are in steps of the sequence
+typedef struct player_note {
+    // the step the note starts on. notes must be in order of step
+    unsigned short step;
+    // the number of steps the note lasts
+    unsigned short length;
+    // the MIDI note number, where 69 is A4 (440Hz)
+    unsigned char note;
+    // the player_waveform_t the note plays with
+    unsigned char waveform;
+    // the gain of the note, from 0 to 255
+    unsigned char velocity;
+} player_note_t;
+// the most tracks of a MIDI file that are played. later tracks are ignored
+#define PLAYER_MIDI_TRACKS 16
+// the number of parsed MIDI events held ahead of playback. this is also
+// the most events handled in one block
+#define PLAYER_MIDI_QUEUE 32
+// the color of a noise voice
+typedef enum {
+    // equal energy at every frequency
+    PLAYER_NOISE_WHITE = 0,
+    // equal energy in every octave, falling 3dB per octave
+    PLAYER_NOISE_PINK,
+    // falling 6dB per octave, like a rumble
+    PLAYER_NOISE_BROWN
+} player_noise_t;
+// the most operators an FM voice can have
+#define PLAYER_FM_OPERATORS 4
+// an operator of an FM voice
+typedef struct player_fm_operator {
+    // the operator's frequency as a multiple of the voice's
+    float ratio;
+    // for the carrier, its output level. for a modulator, how far it
+    // swings the phase of the operator it modulates, in radians
+    float index;
+    // the operator's ADSR envelope. times are in seconds
+    float attack;
+    float decay;
+    float sustain;
+    float release;
+} player_fm_operator_t;
+// the most channels a MOD module can have
+#define PLAYER_MOD_CHANNELS 8
 // info used for custom voice functions
 typedef struct voice_function_info {
     void* buffer;
@@ -22,27 +118,93 @@ typedef void (*player_on_sound_disable_callback)(void* state);
 typedef void (*player_on_sound_enable_callback)(void* state);
 // called when there's sound data to send to the output
 typedef void (*player_on_flush_callback)(const void* buffer, size_t buffer_size, void* state);
+// called to borrow the sink's buffer to render the next block straight
+// into, before the block is rendered. return null when there's no room,
+// and the block is rendered by the next update() instead. a buffer that
+// isn't committed, because the sound is off, is just left unused
+typedef void* (*player_on_acquire_buffer_callback)(size_t buffer_size, void* state);
+// called to hand a buffer that came from acquire back to the sink once
+// the block has been rendered into it
+typedef void (*player_on_commit_buffer_callback)(void* buffer, size_t buffer_size, void* state);
+// called when a voice finishes on its own, just before it is freed
+typedef void (*player_on_voice_finished_callback)(voice_handle_t handle, void* state);
+// called when update() runs later than the block period allows. lateness is in microseconds
+typedef void (*player_on_deadline_miss_callback)(unsigned long lateness, void* state);
 // called to read a byte off a stream
 typedef int (*player_on_read_stream_callback)(void* state);
 // called to seek a stream
 typedef void (*player_on_seek_stream_callback)(unsigned long long pos, void* state);
+#ifdef PLAYER_INSTRUMENTATION
+// the number of timing histogram buckets. each covers 1/8th of the block
+// deadline, and the last one also counts everything longer than that
+#define PLAYER_TIMING_BUCKETS 16
+// timing statistics, in ticks (CPU cycles where the platform has a cycle counter)
+typedef struct player_timing {
+    unsigned long long count;
+    // the average is total/count
+    unsigned long long total;
+    unsigned long min;
+    unsigned long max;
+    unsigned long histogram[PLAYER_TIMING_BUCKETS];
+} player_timing_t;
+#endif
 // represents a polyphonic player capable of playing wavs or various waveforms
 class player final {
     voice_handle_t m_first;
+    void* m_ports;
+    void* m_sequences;
+    void* m_midi;
+    void* m_mods;
     void* m_buffer;
+    void* m_buffer_external;
+    size_t m_buffer_external_size;
+    float* m_mix;
+    float* m_bus;
+    float* m_voice_mix;
+    void* m_filters;
+    float* m_send;
+    void* m_effects;
+    float* m_limiter_delay;
+    bool m_limiter;
+    float m_limiter_threshold;
+    float m_limiter_release;
+    float m_limiter_gain;
+    float m_limiter_peak;
+    void* m_scratch;
     size_t m_frame_count;
+    unsigned long long m_clock;
+    size_t m_sink_latency;
+    uint32_t m_noise_seed;
     unsigned int m_sample_rate;
     unsigned int m_channel_count;
     unsigned int m_bit_depth;
+    player_format_t m_format;
     unsigned int m_sample_max;
     bool m_auto_disable;
     bool m_sound_enabled;
+    bool m_buffer_silent;
     player_on_sound_disable_callback m_on_sound_disable_cb;
     void* m_on_sound_disable_state;
     player_on_sound_enable_callback m_on_sound_enable_cb;
     void* m_on_sound_enable_state;
     player_on_flush_callback m_on_flush_cb;
     void* m_on_flush_state;
+    player_on_acquire_buffer_callback m_on_acquire_buffer_cb;
+    void* m_on_acquire_buffer_state;
+    player_on_commit_buffer_callback m_on_commit_buffer_cb;
+    void* m_on_commit_buffer_state;
+    player_on_deadline_miss_callback m_on_deadline_miss_cb;
+    void* m_on_deadline_miss_state;
+    unsigned long long m_last_update;
+    bool m_last_update_valid;
+    float m_deadline_tolerance;
+    unsigned long m_late_blocks;
+    unsigned long m_max_lateness;
+    unsigned long long m_total_lateness;
+#ifdef PLAYER_INSTRUMENTATION
+    player_timing_t m_render_timing;
+    player_timing_t m_flush_timing;
+#endif
     void*(*m_allocator)(size_t);
     void*(*m_reallocator)(void*,size_t);
     void(*m_deallocator)(void*);
@@ -50,8 +212,19 @@ class player final {
     player& operator=(const player& rhs)=delete;
     void do_move(player& rhs);
     bool realloc_buffer();
+    void free_buffers();
+    bool mix();
+    void limiter_reset();
+    bool limit(bool audible);
+    void* output(bool audible, void* acquired);
+    void sequencer();
+    bool midi_start(void* info, unsigned short port, float amplitude, bool loop, size_t voices);
+    void midi_events();
+    void mod_ticks();
+    void check_deadline();
 public:
-    // construct the player with the specified arguments
+    // construct the player with the specified arguments. buffers are
+    // allocated aligned through the allocator, so the reallocator is unused
     player(unsigned int sample_rate = 44100, 
         unsigned short channels = 2, 
         unsigned short bit_depth = 16, 
@@ -59,6 +232,14 @@ public:
         void*(allocator)(size_t)=::malloc,
         void*(reallocator)(void*,size_t)=::realloc,
         void(deallocator)(void*)=::free);
+    // construct the player to output the specified sample format
+    player(unsigned int sample_rate, 
+        unsigned short channels, 
+        player_format_t format, 
+        size_t frame_count = 256, 
+        void*(allocator)(size_t)=::malloc,
+        void*(reallocator)(void*,size_t)=::realloc,
+        void(deallocator)(void*)=::free);
     player(player&& rhs);
     ~player();
     player& operator=(player&& rhs);
@@ -76,6 +257,16 @@ public:
     voice_handle_t saw(unsigned short port, float frequency, float amplitude = .8);
     // plays a triangle wave at the specified frequency and amplitude
     voice_handle_t tri(unsigned short port, float frequency, float amplitude = .8);
+    // plays white, pink or brown noise at the specified amplitude
+    voice_handle_t noise(unsigned short port, player_noise_t type = PLAYER_NOISE_WHITE, float amplitude = .8);
+    // plays an FM voice with up to PLAYER_FM_OPERATORS operators. operator 0
+    // is the carrier, and each operator modulates the one before it.
+    // release() releases every operator, and the voice ends with the carrier
+    voice_handle_t fm(unsigned short port, 
+                    float frequency, 
+                    const player_fm_operator_t* operators, 
+                    size_t operator_count, 
+                    float amplitude = .8);
     // plays RIFF PCM wav data at the specified amplitude, optionally looping
     voice_handle_t wav(unsigned short port, 
                     player_on_read_stream_callback on_read_stream, 
@@ -84,20 +275,179 @@ public:
                     bool loop = false,
                     player_on_seek_stream_callback on_seek_stream = nullptr, 
                     void* on_seek_stream_state=nullptr);
-    // plays a custom voice
+    // plays a custom voice. custom voices render unsigned samples, 8-bit
+    // for PLAYER_FORMAT_U8 output and 16-bit for every other format
     voice_handle_t voice(unsigned short port, 
                         voice_function_t fn, 
                         void* state = nullptr);
-    // stops a playing voice, or all voices
+    // get the amplitude of a voice
+    float amplitude(voice_handle_t handle) const;
+    // set the amplitude of a voice. the change is ramped over the next block
+    bool amplitude(voice_handle_t handle, float value);
+    // get the stereo position of a voice, from -1 (left) to 1 (right)
+    float pan(voice_handle_t handle) const;
+    // set the stereo position of a voice. the change is ramped over the next block.
+    // stereo wavs are balanced rather than panned, so they never get louder
+    bool pan(voice_handle_t handle, float value);
+    // get the frequency of a waveform or FM voice
+    float frequency(voice_handle_t handle) const;
+    // set the frequency of a waveform or FM voice. waveform changes are ramped over the next block
+    bool frequency(voice_handle_t handle, float value);
+    // attaches an ADSR envelope to a voice and starts its attack. times are in seconds.
+    // release() starts the release, after which the voice is stopped
+    bool envelope(voice_handle_t handle, float attack, float decay, float sustain, float release);
+    // ramps the envelope level of a voice over the specified time,
+    // optionally stopping the voice when the ramp finishes
+    bool ramp(voice_handle_t handle, float level, float seconds, bool exponential = false, bool stop = false);
+    // releases a voice (note off). voices without a release time are stopped immediately
+    bool release(voice_handle_t handle);
+    // set the callback for when a voice finishes on its own, such as a wav
+    // reaching its end or an envelope finishing its release. finished voices
+    // are freed automatically at the end of the block
+    bool on_voice_finished(voice_handle_t handle, player_on_voice_finished_callback cb, void* state=nullptr);
+    // stops a playing voice, or all voices, sequences, MIDI files and modules
     bool stop(voice_handle_t handle = nullptr);
-    // stops all playing voices on a port
+    // stops all playing voices, the sequence, the MIDI file and the module on a port
     bool stop_port(unsigned short port);
+    // plays a sequence of notes on a port, replacing any sequence already
+    // there. notes are played by a pool of voices allocated up front, and
+    // notes that find every voice busy are dropped. the notes aren't copied
+    // and must stay valid while the sequence plays. steps is the length of
+    // the sequence, and step_seconds the length of each step
+    bool sequence(unsigned short port, 
+                const player_note_t* notes, 
+                size_t note_count, 
+                unsigned short steps, 
+                float step_seconds, 
+                bool loop = true, 
+                size_t voices = 4);
+    // indicates whether a sequence is playing on a port
+    bool sequence_playing(unsigned short port) const;
+    // stops the sequence on a port
+    bool stop_sequence(unsigned short port);
+    // plays a Standard MIDI File from a stream on a port, replacing any
+    // file already playing there. the file is parsed a few events ahead of
+    // playback, and notes are played by a pool of voices allocated up front,
+    // with the oldest note cut when they're all busy. channels use a
+    // waveform picked by their program, and the drum channel is skipped.
+    // files with more than one track, and looping, need a seekable stream
+    bool midi(unsigned short port, 
+            player_on_read_stream_callback on_read_stream, 
+            void* on_read_stream_state, 
+            float amplitude = .5, 
+            bool loop = false, 
+            player_on_seek_stream_callback on_seek_stream = nullptr, 
+            void* on_seek_stream_state = nullptr, 
+            size_t voices = 8);
+    // plays a Standard MIDI File from memory on a port. the data
+    // isn't copied and must stay valid while the file plays
+    bool midi(unsigned short port, 
+            const void* data, 
+            size_t size, 
+            float amplitude = .5, 
+            bool loop = false, 
+            size_t voices = 8);
+    // sets the waveform a MIDI channel plays with, regardless of its program
+    bool midi_waveform(unsigned short port, unsigned char channel, player_waveform_t waveform);
+    // indicates whether a MIDI file is playing on a port
+    bool midi_playing(unsigned short port) const;
+    // stops the MIDI file on a port
+    bool stop_midi(unsigned short port);
+    // plays a ProTracker MOD module with 4, 6 or 8 channels from memory on
+    // a port, replacing any module already there. the samples are played
+    // straight out of the data, which isn't copied and must stay valid while
+    // the module plays, so it can live in flash
+    bool mod(unsigned short port, 
+            const void* data, 
+            size_t size, 
+            float amplitude = .5, 
+            bool loop = true);
+    // indicates whether a module is playing on a port
+    bool mod_playing(unsigned short port) const;
+    // stops the module on a port
+    bool stop_mod(unsigned short port);
+    // the number of frames rendered since the player was created.
+    // start_at() and stop_at() are scheduled on this clock
+    unsigned long long frame_clock() const;
+    // holds a voice silent until the specified frame on the clock. the
+    // voice starts exactly on that frame, even in the middle of a block
+    bool start_at(voice_handle_t handle, unsigned long long frame);
+    // stops a voice exactly on the specified frame on the clock. frames
+    // that have already passed stop it at the start of the next block
+    bool stop_at(voice_handle_t handle, unsigned long long frame);
+    // gets the playback position of a voice in frames. for wav voices this
+    // is the position in the wav, otherwise it's the frames played so far
+    bool position(voice_handle_t handle, unsigned long long* out_frame) const;
+    // gets the number of frames before a voice ends, from the end of a wav
+    // that doesn't loop or its stop_at() frame. returns false if it has no end
+    bool remaining(voice_handle_t handle, unsigned long long* out_frames) const;
+    // get the number of frames the sink buffers after a block is sent
+    size_t sink_latency() const;
+    // set the number of frames the sink buffers after a block is sent,
+    // such as the size of a DMA ring, so latency() can account for it
+    void sink_latency(size_t frames);
+    // estimates the frames between a frame being rendered and being heard.
+    // frame_clock()-latency() is roughly the frame playing right now
+    unsigned long long latency() const;
+    // get the gain applied to a port's submix
+    float port_gain(unsigned short port) const;
+    // set the gain applied to a port's submix
+    bool port_gain(unsigned short port, float value);
+    // indicates if a port is muted
+    bool port_mute(unsigned short port) const;
+    // mutes or unmutes a port
+    bool port_mute(unsigned short port, bool value);
+    // indicates if a port is soloed
+    bool port_solo(unsigned short port) const;
+    // solos or unsolos a port. while any port is soloed, only soloed ports are heard
+    bool port_solo(unsigned short port, bool value);
+    // sets a stage of a voice's filter chain. frequency is in Hz, gain is
+    // in dB and only used by the shelf and peak filters. stages run in order
+    // and take effect on the next block. PLAYER_FILTER_NONE turns one off
+    bool filter(voice_handle_t handle, 
+                size_t stage, 
+                player_filter_t type, 
+                float frequency = 1000.0f, 
+                float q = .7071f, 
+                float gain = 0.0f);
+    // sets a stage of a port's filter chain, which filters the port's submix
+    bool port_filter(unsigned short port, 
+                    size_t stage, 
+                    player_filter_t type, 
+                    float frequency = 1000.0f, 
+                    float q = .7071f, 
+                    float gain = 0.0f);
+    // sets a stage of the filter chain on the final mix
+    bool master_filter(size_t stage, 
+                    player_filter_t type, 
+                    float frequency = 1000.0f, 
+                    float q = .7071f, 
+                    float gain = 0.0f);
+    // get how much of a port's submix is sent to the shared effects
+    float port_send(unsigned short port) const;
+    // set how much of a port's submix is sent to the shared effects, 
+    // after the port's gain and filters. 0 sends nothing
+    bool port_send(unsigned short port, float value);
+    // sets up the feedback delay on the effects return. feedback is from 0
+    // to just under 1, and level is how loud the return is. a level or time 
+    // of 0 turns it off and frees its delay line. changing the time clears it
+    bool send_delay(float seconds, float feedback = .35f, float level = .5f);
+    // sets up the reverb on the effects return. size and damping are from
+    // 0 to 1. a level of 0 turns it off and frees its delay lines
+    bool send_reverb(float size = .5f, float damping = .5f, float level = .3f);
     // set the sound disable callback
     void on_sound_disable(player_on_sound_disable_callback cb, void* state=nullptr);
     // set the sound enable callback
     void on_sound_enable(player_on_sound_enable_callback cb, void* state=nullptr);
     // set the flush callback (always necessary)
     void on_flush(player_on_flush_callback cb, void* state=nullptr);
+    // set the callback that lends the sink's buffer to render into. when
+    // set it's used instead of the flush callback, saving a copy per block
+    void on_acquire_buffer(player_on_acquire_buffer_callback cb, void* state=nullptr);
+    // set the callback that sends a buffer from acquire to the output
+    void on_commit_buffer(player_on_commit_buffer_callback cb, void* state=nullptr);
+    // set the callback for when a block starts late
+    void on_deadline_miss(player_on_deadline_miss_callback cb, void* state=nullptr);
     // A frame is every sample for every channel on a given a tick.
     // A stereo frame would have two samples.
     // This is the count of frames in the mixing buffer.
@@ -112,12 +462,23 @@ public:
     unsigned short channel_count() const;
     // set the number of channels
     bool channel_count(unsigned short value);
-    // get the bit depth
+    // get the bit depth of each sample in the output buffer
     unsigned short bit_depth() const;
-    // set the bit depth
+    // set the bit depth, selecting the unsigned 8 or 16-bit format
     bool bit_depth(unsigned short value);
+    // get the output sample format
+    player_format_t format() const;
+    // set the output sample format
+    bool format(player_format_t value);
     // indicates the size of the internal audio buffer
     size_t buffer_size() const;
+    // the output buffer, or null if not initialized
+    void* buffer() const;
+    // render into caller owned storage, such as DMA capable memory, instead
+    // of an allocated buffer. it must be aligned to PLAYER_BUFFER_ALIGNMENT,
+    // hold at least buffer_size() bytes, and stay valid while in use. format
+    // changes that would outgrow it fail. null goes back to an internal buffer
+    bool buffer(void* buffer, size_t size);
     // indicates the bandwidth required to play the buffer
     size_t bytes_per_second() {
         return m_sample_rate*m_channel_count*(m_bit_depth/8);
@@ -128,6 +489,55 @@ public:
     void sound_enabled(bool value);
     // give a timeslice to the player to update itself
     void update();
+    // renders the specified number of seconds as fast as possible by calling
+    // update() repeatedly, for offline rendering into a sink. use
+    // auto_disable(false) if silent stretches should be output too.
+    // returns the number of frames rendered, which is a whole number of
+    // blocks, less any a sink had no room for
+    unsigned long long render(float seconds);
+    // A block is late when the time since the previous update() exceeds
+    // the block period (frame_count/sample_rate) by more than this
+    // fraction of the period. Defaults to .25 to ignore scheduling jitter
+    float deadline_tolerance() const;
+    // set the deadline tolerance as a fraction of the block period
+    bool deadline_tolerance(float value);
+    // indicates if the master limiter is on
+    bool limiter() const;
+    // turns the master limiter on or off. it holds the mix under the
+    // threshold without clipping, at the cost of one block of latency
+    bool limiter(bool value);
+    // get the level the limiter holds the mix under, from 0 to 1
+    float limiter_threshold() const;
+    // set the level the limiter holds the mix under, from 0 to 1
+    bool limiter_threshold(float value);
+    // get the time the limiter takes to recover most of its gain, in seconds
+    float limiter_release() const;
+    // set the limiter's release time in seconds
+    bool limiter_release(float value);
+    // the gain the limiter applied at the end of the last block
+    float limiter_gain() const;
+    // the number of blocks that started late
+    unsigned long late_blocks() const;
+    // the longest a block has started late, in microseconds
+    unsigned long max_lateness() const;
+    // the total time blocks have started late, in microseconds
+    unsigned long long total_lateness() const;
+    // resets the late block statistics
+    void reset_late_blocks();
+#ifdef PLAYER_INSTRUMENTATION
+    // timing of each render of the voices into the buffer
+    const player_timing_t& render_timing() const;
+    // timing of each call to the flush callback
+    const player_timing_t& flush_timing() const;
+    // timing of each call to a voice's function
+    bool voice_timing(voice_handle_t handle, player_timing_t* out_timing) const;
+    // the time available to render and flush a block (frame_count/sample_rate), in ticks
+    unsigned long block_deadline() const;
+    // the number of ticks per second
+    unsigned long ticks_per_second() const;
+    // resets all the timing statistics
+    void reset_timing();
+#endif
     // allocates memory for a custom voice state
     template<typename T>
     T* allocate_voice_state() const {
@@ -0,0 +1,53 @@
+#pragma once
+#include <player.hpp>
+#include <stdio.h>
+// writes player output to a RIFF wav or raw PCM file using large buffered
+// writes. attach it to a player and drive the player with render() to
+// produce audio faster than realtime, or with update() as usual
+class player_file_sink final {
+    FILE* m_file;
+    bool m_wav;
+    unsigned int m_sample_rate;
+    unsigned short m_channel_count;
+    unsigned short m_bit_depth;
+    player_format_t m_format;
+    unsigned char* m_buffer;
+    size_t m_capacity;
+    size_t m_buffered;
+    unsigned long long m_data_size;
+    bool m_error;
+    void*(*m_allocator)(size_t);
+    void(*m_deallocator)(void*);
+    player_file_sink(const player_file_sink& rhs)=delete;
+    player_file_sink& operator=(const player_file_sink& rhs)=delete;
+    bool write_header();
+    bool flush_buffer();
+    void write(const void* buffer, size_t buffer_size);
+public:
+    // construct the sink with the specified write buffer size
+    player_file_sink(size_t buffer_size = 64*1024,
+        void*(allocator)(size_t)=::malloc,
+        void(deallocator)(void*)=::free);
+    ~player_file_sink();
+    // opens a file to receive the output of the specified player, in its current format.
+    // wav files get a RIFF header, otherwise the raw PCM is written as produced.
+    // wav can't hold PLAYER_FORMAT_S24_32, so only raw files are written for it
+    bool open(const char* path, const player& source, bool wav = true);
+    // indicates if the sink is open
+    bool is_open() const;
+    // writes any buffered data, finalizes the header and closes the file
+    bool close();
+    // points the player's output at this sink. when a block fits in the
+    // write buffer the player renders directly into it
+    void attach(player& source);
+    // the number of PCM bytes written (or buffered) so far
+    unsigned long long data_size() const;
+    // indicates if a write has failed since the file was opened
+    bool error() const;
+    // the flush callback, taking the sink as its state
+    static void on_flush(const void* buffer, size_t buffer_size, void* state);
+    // the acquire buffer callback, taking the sink as its state
+    static void* on_acquire_buffer(size_t buffer_size, void* state);
+    // the commit buffer callback, taking the sink as its state
+    static void on_commit_buffer(void* buffer, size_t buffer_size, void* state);
+};
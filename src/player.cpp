@@ -6,30 +6,175 @@
 #include <stddef.h>
 #include <math.h>
 #include <string.h>
+#include <chrono>
 #define PI (3.1415926535f)
 #endif
 
 constexpr static const float player_pi = PI;
+// a frame on the player's clock that never comes
+constexpr static const unsigned long long player_never = ~0ULL;
 constexpr static const float player_two_pi = player_pi*2.0f;
 
+// a monotonic clock for measuring the player. elapsed ticks are taken as
+// the unsigned difference of two readings, so wrapping is harmless
+#if defined(ARDUINO_ARCH_ESP32)
+typedef uint32_t player_ticks_t;
+static inline player_ticks_t player_ticks() {
+    return ESP.getCycleCount();
+}
+static inline unsigned long player_ticks_per_second() {
+    return ESP.getCpuFreqMHz()*1000000UL;
+}
+#elif defined(ARDUINO)
+typedef uint32_t player_ticks_t;
+static inline player_ticks_t player_ticks() {
+    return micros();
+}
+static inline unsigned long player_ticks_per_second() {
+    return 1000000UL;
+}
+#else
+typedef uint64_t player_ticks_t;
+static inline player_ticks_t player_ticks() {
+    return (player_ticks_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static inline unsigned long player_ticks_per_second() {
+    return 1000000000UL;
+}
+#endif
+#ifdef PLAYER_INSTRUMENTATION
+static void player_timing_reset(player_timing_t* timing) {
+    memset(timing,0,sizeof(player_timing_t));
+}
+static void player_timing_record(player_timing_t* timing, 
+                                player_ticks_t elapsed, 
+                                unsigned long deadline) {
+    if(timing->count==0 || elapsed<timing->min) {
+        timing->min = (unsigned long)elapsed;
+    }
+    if(elapsed>timing->max) {
+        timing->max = (unsigned long)elapsed;
+    }
+    ++timing->count;
+    timing->total+=elapsed;
+    size_t bucket = PLAYER_TIMING_BUCKETS-1;
+    if(deadline!=0) {
+        const unsigned long long b = ((unsigned long long)elapsed*8)/deadline;
+        if(b<bucket) {
+            bucket = (size_t)b;
+        }
+    }
+    ++timing->histogram[bucket];
+}
+#define PLAYER_TIMING_START(name) const player_ticks_t name = player_ticks()
+#define PLAYER_TIMING_RECORD(timing,start,deadline) player_timing_record(timing,(player_ticks_t)(player_ticks()-start),deadline)
+#else
+#define PLAYER_TIMING_START(name)
+#define PLAYER_TIMING_RECORD(timing,start,deadline)
+#endif
+
+// info used for the built in voices, which mix into a float bus
+typedef struct mix_function_info {
+    // when null, the voice should just advance over the block without
+    // producing anything, because it would be silent
+    float* buffer;
+    size_t frame_count;
+    unsigned int channel_count;
+    // the left and right voice gains at the start of the block, and
+    // the per frame increments that ramp them to their targets.
+    // mono outputs only use the first.
+    float gain[2];
+    float gain_step[2];
+    // true when the voice is the first to write the buffer this block,
+    // so it stores instead of adding and nothing has to clear it first.
+    // a voice mixing in this mode must write the whole block, even if
+    // it finishes partway through
+    bool assign;
+} mix_function_info_t;
+// what a built in voice function produced for a block
+typedef enum {
+    // the voice has finished and can be removed
+    PLAYER_MIX_DONE = 0,
+    PLAYER_MIX_SOUND,
+    // the voice produced nothing but silence
+    PLAYER_MIX_SILENT
+} player_mix_result_t;
+// built in voice function
+typedef player_mix_result_t (*mix_function_t)(const mix_function_info_t& info, void* state);
 typedef struct voice_info {
     unsigned short port;
     voice_function_t fn;
+    mix_function_t mix_fn;
     void* fn_state;
+    float gain;
+    float gain_target;
+    float pan;
+    float pan_target;
+    void* envelope;
+    void* filters;
+    // the frames on the player's clock the voice starts and stops at
+    unsigned long long start;
+    unsigned long long stop;
+    // the number of frames the voice has rendered
+    unsigned long long played;
+    // pooled voices belong to a sequence and go idle instead of finishing
+    bool pooled;
+    // set when the voice is done and should be removed after the block
+    bool finished;
+    player_on_voice_finished_callback on_finished;
+    void* on_finished_state;
+#ifdef PLAYER_INSTRUMENTATION
+    player_timing_t timing;
+#endif
     voice_info* next;
 } voice_info_t;
+enum {
+    PLAYER_ENVELOPE_ATTACK=0,
+    PLAYER_ENVELOPE_DECAY,
+    PLAYER_ENVELOPE_SUSTAIN,
+    PLAYER_ENVELOPE_RAMP,
+    PLAYER_ENVELOPE_HOLD,
+    PLAYER_ENVELOPE_RELEASE,
+    PLAYER_ENVELOPE_DONE
+};
+// an envelope is a series of segments, each moving level toward target
+// over remaining frames, either linearly (rate is the per frame increment)
+// or exponentially (rate is the per frame multiplier of the distance left)
+typedef struct envelope_info {
+    unsigned char stage;
+    bool exponential;
+    // whether a ramp stops the voice when it finishes
+    bool stop;
+    float level;
+    float target;
+    float rate;
+    size_t remaining;
+    size_t decay;
+    float sustain;
+    size_t release;
+} envelope_info_t;
+typedef struct port_info {
+    unsigned short port;
+    float gain;
+    // how much of the submix goes to the effects
+    float send;
+    void* filters;
+    bool mute;
+    bool solo;
+    port_info* next;
+} port_info_t;
 typedef struct {
     float frequency;
-    float amplitude;
     float phase;
     float phase_delta;
+    float phase_delta_target;
 } waveform_info_t;
 typedef struct wav_info {
     player_on_read_stream_callback on_read_stream;
     void* on_read_stream_state;
     player_on_seek_stream_callback on_seek_stream;
     void* on_seek_stream_state;
-    float amplitude;
     bool loop;
     unsigned short channel_count;
     unsigned short bit_depth;
@@ -108,8 +253,9 @@ static bool player_read16s(player_on_read_stream_callback on_read_stream,
     uint16_t res = 0;
     if(player_read16(on_read_stream,on_read_stream_state,&res)) {
         *out = (int16_t)res;
+        return true;
     }
-    return true;
+    return false;
 }
 static bool player_read_fourcc(player_on_read_stream_callback on_read_stream, 
                                 void* on_read_stream_state, 
@@ -123,253 +269,750 @@ static bool player_read_fourcc(player_on_read_stream_callback on_read_stream,
     }
     return true;
 }
-static void sin_voice(const voice_function_info_t& info, void*state) {
-    waveform_info_t* wi = (waveform_info_t*)state;
-    for(int i = 0;i<info.frame_count;++i) {
-        float f = (sinf(wi->phase) + 1.0f) * 0.5f;
-        wi->phase+=wi->phase_delta;
-        if(wi->phase>=player_two_pi) {
-            wi->phase-=player_two_pi;
+// equal power pan law, scaled by sqrt(2) so that center pan is unity
+// gain. index 0 is hard left, and the right gain is the table reversed
+constexpr static const size_t player_pan_table_size = 64;
+static const float player_pan_table[player_pan_table_size+1] = {
+    1.4142136f,1.4137876f,1.4125101f,1.4103817f,1.4074037f,1.4035780f,1.3989068f,1.3933930f,
+    1.3870398f,1.3798512f,1.3718314f,1.3629852f,1.3533180f,1.3428356f,1.3315444f,1.3194511f,
+    1.3065630f,1.2928878f,1.2784339f,1.2632099f,1.2472250f,1.2304888f,1.2130114f,1.1948034f,
+    1.1758756f,1.1562395f,1.1359070f,1.1148902f,1.0932019f,1.0708550f,1.0478631f,1.0242400f,
+    1.0000000f,0.9751576f,0.9497278f,0.9237259f,0.8971676f,0.8700689f,0.8424460f,0.8143158f,
+    0.7856950f,0.7566009f,0.7270511f,0.6970633f,0.6666557f,0.6358464f,0.6046542f,0.5730978f,
+    0.5411961f,0.5089684f,0.4764342f,0.4436130f,0.4105245f,0.3771888f,0.3436259f,0.3098559f,
+    0.2758994f,0.2417766f,0.2075082f,0.1731148f,0.1386172f,0.1040360f,0.0693922f,0.0347065f,
+    0.0000000f
+};
+// stereo sources already have their own image, so they get a balance
+// instead, which only turns the far side down
+static void player_pan_gains(float pan, bool balance, float* out_left, float* out_right) {
+    if(pan<-1.0f) {
+        pan = -1.0f;
+    } else if(pan>1.0f) {
+        pan = 1.0f;
+    }
+    const float f = (pan+1.0f)*(player_pan_table_size*.5f);
+    size_t i = (size_t)f;
+    if(i>=player_pan_table_size) {
+        i = player_pan_table_size-1;
+    }
+    const float frac = f-i;
+    const float* l = player_pan_table+i;
+    const float* r = player_pan_table+(player_pan_table_size-i);
+    *out_left = l[0]+(l[1]-l[0])*frac;
+    *out_right = r[0]+(r[-1]-r[0])*frac;
+    if(balance) {
+        *out_left = *out_left>1.0f?1.0f:*out_left;
+        *out_right = *out_right>1.0f?1.0f:*out_right;
+    }
+}
+static void player_envelope_segment(envelope_info_t* e, 
+                                    unsigned char stage, 
+                                    float target, 
+                                    size_t frames, 
+                                    bool exponential) {
+    e->stage = stage;
+    e->target = target;
+    e->remaining = frames;
+    e->exponential = exponential;
+    if(frames==0) {
+        e->rate = 0.0f;
+    } else if(exponential) {
+        // close to within 1/1000th of the distance by the end, then snap
+        e->rate = powf(.001f,1.0f/frames);
+    } else {
+        e->rate = (target-e->level)/frames;
+    }
+}
+// advances the envelope by a block of frames and returns the level at the end of it
+static float player_envelope_advance(envelope_info_t* e, size_t frames) {
+    while(true) {
+        switch(e->stage) {
+            case PLAYER_ENVELOPE_SUSTAIN:
+            case PLAYER_ENVELOPE_HOLD:
+            case PLAYER_ENVELOPE_DONE:
+                return e->level;
+            default:
+            break;
         }
-        float samp = (f*wi->amplitude)*info.sample_max;
-        switch(info.bit_depth) {
-            case 8: {
-                uint8_t* p = ((uint8_t*)info.buffer)+(i*info.channel_count);
-                uint32_t tmp = *p+roundf(samp);
-                if(tmp>info.sample_max) {
-                    tmp = info.sample_max;
-                }
-                for(int j = 0;j<info.channel_count;++j) {
-                    *p++=tmp;
-                }
+        size_t n = frames<e->remaining?frames:e->remaining;
+        if(n!=0) {
+            if(e->exponential) {
+                e->level = e->target+(e->level-e->target)*powf(e->rate,(float)n);
+            } else {
+                e->level+=e->rate*n;
             }
+            e->remaining-=n;
+            frames-=n;
+        }
+        if(e->remaining!=0) {
+            return e->level;
+        }
+        e->level = e->target;
+        switch(e->stage) {
+            case PLAYER_ENVELOPE_ATTACK:
+                player_envelope_segment(e,PLAYER_ENVELOPE_DECAY,e->sustain,e->decay,false);
+                break;
+            case PLAYER_ENVELOPE_DECAY:
+                e->stage = PLAYER_ENVELOPE_SUSTAIN;
+                break;
+            case PLAYER_ENVELOPE_RAMP:
+                e->stage = e->stop?PLAYER_ENVELOPE_DONE:PLAYER_ENVELOPE_HOLD;
+                break;
+            default: // PLAYER_ENVELOPE_RELEASE
+                e->stage = PLAYER_ENVELOPE_DONE;
+                break;
+        }
+    }
+}
+// one biquad in a filter chain. the state is kept per channel for
+// up to two channels, in transposed direct form II
+typedef struct filter_stage {
+    player_filter_t type;
+    float frequency;
+    float q;
+    float gain;
+    float b0, b1, b2, a1, a2;
+    float z1[2];
+    float z2[2];
+} filter_stage_t;
+typedef struct filter_info {
+    filter_stage_t stages[PLAYER_FILTER_STAGES];
+    // the sample rate the coefficients were computed for. zero when
+    // a stage has changed and they need to be computed again
+    unsigned int sample_rate;
+} filter_info_t;
+// the coefficients for a stage, from the RBJ audio EQ cookbook
+static void player_filter_coefficients(filter_stage_t* st, unsigned int sample_rate) {
+    float frequency = st->frequency;
+    if(frequency>sample_rate*.49f) {
+        frequency = sample_rate*.49f;
+    }
+    const float w0 = player_two_pi*frequency/sample_rate;
+    const float cs = cosf(w0);
+    const float alpha = sinf(w0)/(2.0f*st->q);
+    const float a = powf(10.0f,st->gain/40.0f);
+    const float sqrt_a_alpha = 2.0f*sqrtf(a)*alpha;
+    float b0, b1, b2, a0, a1, a2;
+    switch(st->type) {
+        case PLAYER_FILTER_LOWPASS:
+            b0 = (1.0f-cs)*.5f; b1 = 1.0f-cs; b2 = b0;
+            a0 = 1.0f+alpha; a1 = -2.0f*cs; a2 = 1.0f-alpha;
+            break;
+        case PLAYER_FILTER_HIGHPASS:
+            b0 = (1.0f+cs)*.5f; b1 = -(1.0f+cs); b2 = b0;
+            a0 = 1.0f+alpha; a1 = -2.0f*cs; a2 = 1.0f-alpha;
+            break;
+        case PLAYER_FILTER_BANDPASS:
+            b0 = alpha; b1 = 0.0f; b2 = -alpha;
+            a0 = 1.0f+alpha; a1 = -2.0f*cs; a2 = 1.0f-alpha;
+            break;
+        case PLAYER_FILTER_LOWSHELF:
+            b0 = a*((a+1.0f)-(a-1.0f)*cs+sqrt_a_alpha);
+            b1 = 2.0f*a*((a-1.0f)-(a+1.0f)*cs);
+            b2 = a*((a+1.0f)-(a-1.0f)*cs-sqrt_a_alpha);
+            a0 = (a+1.0f)+(a-1.0f)*cs+sqrt_a_alpha;
+            a1 = -2.0f*((a-1.0f)+(a+1.0f)*cs);
+            a2 = (a+1.0f)+(a-1.0f)*cs-sqrt_a_alpha;
+            break;
+        case PLAYER_FILTER_HIGHSHELF:
+            b0 = a*((a+1.0f)+(a-1.0f)*cs+sqrt_a_alpha);
+            b1 = -2.0f*a*((a-1.0f)+(a+1.0f)*cs);
+            b2 = a*((a+1.0f)+(a-1.0f)*cs-sqrt_a_alpha);
+            a0 = (a+1.0f)-(a-1.0f)*cs+sqrt_a_alpha;
+            a1 = 2.0f*((a-1.0f)-(a+1.0f)*cs);
+            a2 = (a+1.0f)-(a-1.0f)*cs-sqrt_a_alpha;
             break;
-            case 16: {
-                uint16_t* p = ((uint16_t*)info.buffer)+(i*info.channel_count);
-                uint32_t tmp = *p+roundf(samp);
-                if(tmp>info.sample_max) {
-                    tmp = info.sample_max;
+        case PLAYER_FILTER_PEAK:
+            b0 = 1.0f+alpha*a; b1 = -2.0f*cs; b2 = 1.0f-alpha*a;
+            a0 = 1.0f+alpha/a; a1 = -2.0f*cs; a2 = 1.0f-alpha/a;
+            break;
+        default:
+            // passes everything through
+            b0 = 1.0f; b1 = b2 = a1 = a2 = 0.0f; a0 = 1.0f;
+            break;
+    }
+    st->b0 = b0/a0;
+    st->b1 = b1/a0;
+    st->b2 = b2/a0;
+    st->a1 = a1/a0;
+    st->a2 = a2/a0;
+}
+// sets a stage in a chain, allocating the chain if necessary. the new
+// coefficients are computed at the start of the next block
+static bool player_filter_set(void** in_out_filters, 
+                            size_t stage, 
+                            player_filter_t type, 
+                            float frequency, 
+                            float q, 
+                            float gain, 
+                            void*(allocator)(size_t)) {
+    if(stage>=PLAYER_FILTER_STAGES || type<PLAYER_FILTER_NONE || type>PLAYER_FILTER_PEAK) {
+        return false;
+    }
+    if(type!=PLAYER_FILTER_NONE && (!(frequency>0.0f) || !(q>0.0f))) {
+        return false;
+    }
+    filter_info_t* f = (filter_info_t*)*in_out_filters;
+    if(f==nullptr) {
+        if(type==PLAYER_FILTER_NONE) {
+            return true;
+        }
+        f = (filter_info_t*)allocator(sizeof(filter_info_t));
+        if(f==nullptr) {
+            return false;
+        }
+        memset(f,0,sizeof(filter_info_t));
+        *in_out_filters = f;
+    }
+    filter_stage_t* st = f->stages+stage;
+    if(st->type==PLAYER_FILTER_NONE) {
+        // a stage coming in starts from rest
+        st->z1[0] = st->z1[1] = st->z2[0] = st->z2[1] = 0.0f;
+    }
+    st->type = type;
+    st->frequency = frequency;
+    st->q = q;
+    st->gain = gain;
+    f->sample_rate = 0;
+    return true;
+}
+// runs a buffer through each stage of a chain in turn. stereo is run
+// in lockstep so both channels share each pass over the buffer
+static void player_filter_process(filter_info_t* f, 
+                                float* buffer, 
+                                size_t frame_count, 
+                                unsigned int channel_count, 
+                                unsigned int sample_rate) {
+    const bool recompute = f->sample_rate!=sample_rate;
+    f->sample_rate = sample_rate;
+    const unsigned int channels = channel_count<2?channel_count:2;
+    for(size_t s = 0;s<PLAYER_FILTER_STAGES;++s) {
+        filter_stage_t* st = f->stages+s;
+        if(st->type==PLAYER_FILTER_NONE) {
+            continue;
+        }
+        if(recompute) {
+            player_filter_coefficients(st,sample_rate);
+        }
+        const float b0 = st->b0, b1 = st->b1, b2 = st->b2, a1 = st->a1, a2 = st->a2;
+        float z1[2] = {st->z1[0],st->z1[1]};
+        float z2[2] = {st->z2[0],st->z2[1]};
+        float* p = buffer;
+        for(size_t i = 0;i<frame_count;++i) {
+            for(unsigned int j = 0;j<channels;++j) {
+                const float x = p[j];
+                const float y = b0*x+z1[j];
+                z1[j] = b1*x-a1*y+z2[j];
+                z2[j] = b2*x-a2*y;
+                p[j] = y;
+            }
+            p+=channel_count;
+        }
+        // flush denormals from decaying tails, which are very slow on some CPUs
+        for(unsigned int j = 0;j<2;++j) {
+            st->z1[j] = fabsf(z1[j])<1e-15f?0.0f:z1[j];
+            st->z2[j] = fabsf(z2[j])<1e-15f?0.0f:z2[j];
+        }
+    }
+}
+// the shared effects on the send/return bus. the reverb is a mono in, 
+// stereo out Schroeder reverb in the style of freeverb: four damped 
+// combs in parallel, then two allpasses per channel, the right 
+// channel's slightly longer to spread the image
+#define PLAYER_REVERB_COMBS 4
+#define PLAYER_REVERB_ALLPASSES 2
+typedef struct effects_info {
+    float* delay_line;
+    size_t delay_length;
+    size_t delay_pos;
+    float delay_feedback;
+    float delay_level;
+    // every reverb line in one allocation
+    float* reverb_lines;
+    float* comb[PLAYER_REVERB_COMBS];
+    size_t comb_length[PLAYER_REVERB_COMBS];
+    size_t comb_pos[PLAYER_REVERB_COMBS];
+    float comb_store[PLAYER_REVERB_COMBS];
+    float* allpass[2][PLAYER_REVERB_ALLPASSES];
+    size_t allpass_length[2][PLAYER_REVERB_ALLPASSES];
+    size_t allpass_pos[2][PLAYER_REVERB_ALLPASSES];
+    float reverb_feedback;
+    float reverb_damping;
+    float reverb_level;
+    // the frames the return has been quiet with nothing sent
+    size_t quiet;
+    // set once the tails have died away and the lines are cleared,
+    // so the effects can be skipped until something is sent again
+    bool idle;
+} effects_info_t;
+// freeverb's line lengths at 44.1kHz
+static const size_t player_reverb_comb_tuning[PLAYER_REVERB_COMBS] = {1116,1188,1277,1356};
+static const size_t player_reverb_allpass_tuning[PLAYER_REVERB_ALLPASSES] = {556,441};
+constexpr static const size_t player_reverb_spread = 23;
+// runs the effects over the mono send bus (or silence when send is
+// null) and mixes their stereo return into the float mix. returns
+// false once the tails have died away and the effects went idle
+static bool player_effects_process(effects_info_t* fx, 
+                                const float* send, 
+                                float* mix, 
+                                size_t frame_count, 
+                                unsigned int channel_count, 
+                                bool assign) {
+    float peak = 0.0f;
+    float* p = mix;
+    for(size_t i = 0;i<frame_count;++i) {
+        const float x = send==nullptr?0.0f:send[i];
+        float left = 0.0f, right = 0.0f;
+        if(fx->delay_line!=nullptr) {
+            float* d = fx->delay_line+fx->delay_pos;
+            const float y = *d;
+            *d = x+y*fx->delay_feedback;
+            if(++fx->delay_pos==fx->delay_length) {
+                fx->delay_pos = 0;
+            }
+            left = right = y*fx->delay_level;
+        }
+        if(fx->reverb_lines!=nullptr) {
+            const float in = x*.015f;
+            float acc = 0.0f;
+            for(size_t c = 0;c<PLAYER_REVERB_COMBS;++c) {
+                float* d = fx->comb[c]+fx->comb_pos[c];
+                const float y = *d;
+                fx->comb_store[c] = y+(fx->comb_store[c]-y)*fx->reverb_damping;
+                *d = in+fx->comb_store[c]*fx->reverb_feedback;
+                if(++fx->comb_pos[c]==fx->comb_length[c]) {
+                    fx->comb_pos[c] = 0;
                 }
-                for(int j = 0;j<info.channel_count;++j) {
-                    *p++=tmp;
+                acc+=y;
+            }
+            float ch[2] = {acc,acc};
+            for(size_t j = 0;j<2;++j) {
+                for(size_t a = 0;a<PLAYER_REVERB_ALLPASSES;++a) {
+                    float* d = fx->allpass[j][a]+fx->allpass_pos[j][a];
+                    const float b = *d;
+                    *d = ch[j]+b*.5f;
+                    ch[j] = b-ch[j];
+                    if(++fx->allpass_pos[j][a]==fx->allpass_length[j][a]) {
+                        fx->allpass_pos[j][a] = 0;
+                    }
                 }
             }
-            break;
-            default:
-            break;
+            left+=ch[0]*fx->reverb_level;
+            right+=ch[1]*fx->reverb_level;
+        }
+        const float m = fabsf(left)>fabsf(right)?fabsf(left):fabsf(right);
+        peak = m>peak?m:peak;
+        if(channel_count==1) {
+            *p = (left+right)*.5f+(assign?0.0f:*p);
+            ++p;
+        } else {
+            p[0] = left+(assign?0.0f:p[0]);
+            p[1] = right+(assign?0.0f:p[1]);
+            for(unsigned int j = 2;assign && j<channel_count;++j) {
+                p[j] = 0.0f;
+            }
+            p+=channel_count;
+        }
+    }
+    // once nothing has gone in and what came out has been well below the
+    // smallest 16-bit step for longer than a trip through the longest
+    // path, the lines are all but empty, so clear them to skip them
+    if(send!=nullptr || peak>=1e-6f) {
+        fx->quiet = 0;
+        return true;
+    }
+    fx->quiet+=frame_count;
+    size_t longest = fx->delay_line!=nullptr?fx->delay_length:0;
+    if(fx->reverb_lines!=nullptr) {
+        size_t reverb_length = fx->comb_length[PLAYER_REVERB_COMBS-1];
+        for(size_t a = 0;a<PLAYER_REVERB_ALLPASSES;++a) {
+            reverb_length+=fx->allpass_length[1][a];
+        }
+        longest = reverb_length>longest?reverb_length:longest;
+    }
+    if(fx->quiet>longest) {
+        if(fx->delay_line!=nullptr) {
+            memset(fx->delay_line,0,fx->delay_length*sizeof(float));
+        }
+        if(fx->reverb_lines!=nullptr) {
+            size_t total = 0;
+            for(size_t c = 0;c<PLAYER_REVERB_COMBS;++c) {
+                total+=fx->comb_length[c];
+                fx->comb_store[c] = 0.0f;
+            }
+            for(size_t j = 0;j<2;++j) {
+                for(size_t a = 0;a<PLAYER_REVERB_ALLPASSES;++a) {
+                    total+=fx->allpass_length[j][a];
+                }
+            }
+            memset(fx->reverb_lines,0,total*sizeof(float));
+        }
+        fx->idle = true;
+        fx->quiet = 0;
+        return false;
+    }
+    return true;
+}
+// gets the effects, creating them if necessary
+static effects_info_t* player_get_effects(void** in_out_effects, void*(allocator)(size_t)) {
+    effects_info_t* fx = (effects_info_t*)*in_out_effects;
+    if(fx==nullptr) {
+        fx = (effects_info_t*)allocator(sizeof(effects_info_t));
+        if(fx==nullptr) {
+            return nullptr;
+        }
+        memset(fx,0,sizeof(effects_info_t));
+        fx->idle = true;
+        *in_out_effects = fx;
+    }
+    return fx;
+}
+// frees the effects once neither one is in use
+static void player_trim_effects(void** in_out_effects, void(deallocator)(void*)) {
+    effects_info_t* fx = (effects_info_t*)*in_out_effects;
+    if(fx!=nullptr && fx->delay_line==nullptr && fx->reverb_lines==nullptr) {
+        deallocator(fx);
+        *in_out_effects = nullptr;
+    }
+}
+// stores or adds a sample depending on the mixing mode
+template<bool Assign> inline static void player_mix_store(float* p, float value) {
+    if(Assign) {
+        *p = value;
+    } else {
+        *p += value;
+    }
+}
+// called when a voice ends partway through a block. in assign mode
+// nothing else will write the rest of the block, so it gets cleared
+template<bool Assign> inline static player_mix_result_t player_mix_done(float* p, const float* end) {
+    if(Assign) {
+        while(p<end) {
+            *p++=0.0f;
+        }
+    }
+    return PLAYER_MIX_DONE;
+}
+// built in voices are written once per mode, and this picks the
+// right one for the block
+#define PLAYER_MIX_DISPATCH(name) \
+static player_mix_result_t name(const mix_function_info_t& info, void* state) { \
+    return info.assign?name##_mix<true>(info,state):name##_mix<false>(info,state); \
+}
+// advances sin or sqr over a block without producing it
+static void player_waveform_skip(waveform_info_t* wi, size_t frame_count) {
+    wi->phase = fmodf(wi->phase+(wi->phase_delta+wi->phase_delta_target)*.5f*frame_count,player_two_pi);
+    wi->phase_delta = wi->phase_delta_target;
+}
+// advances saw or tri over a block without producing it. at a constant
+// rate the phase steps along a fixed grid and turns around on the last
+// grid points inside -pi and pi, so the position on that round trip is
+// found the same way player_waveform_skip finds the phase
+static void player_waveform_bounce_skip(waveform_info_t* wi, size_t frame_count) {
+    const float delta = wi->phase_delta_target;
+    if(delta<=0.0f) {
+        wi->phase_delta = 0.0f;
+        return;
+    }
+    const float distance = (fabsf(wi->phase_delta)+delta)*.5f*frame_count;
+    const float top = wi->phase+delta*ceilf((player_pi-delta-wi->phase)/delta);
+    const float bottom = wi->phase-delta*ceilf((wi->phase+player_pi-delta)/delta);
+    const float span = top-bottom;
+    if(span<=0.0f) {
+        // at or past the Nyquist rate the phase turns around every frame
+        wi->phase_delta = copysignf(delta,wi->phase_delta);
+        return;
+    }
+    // the first half of the trip rises and the second half falls
+    float t = wi->phase_delta>=0.0f?wi->phase-bottom:span+top-wi->phase;
+    t = fmodf(t+distance,span*2.0f);
+    if(t<span) {
+        wi->phase = bottom+t;
+        wi->phase_delta = delta;
+    } else {
+        wi->phase = top+span-t;
+        wi->phase_delta = -delta;
+    }
+}
+template<bool Assign>
+static player_mix_result_t sin_voice_mix(const mix_function_info_t& info, void*state) {
+    waveform_info_t* wi = (waveform_info_t*)state;
+    if(info.buffer==nullptr) {
+        player_waveform_skip(wi,info.frame_count);
+        return PLAYER_MIX_SILENT;
+    }
+    float* p = info.buffer;
+    float left = info.gain[0];
+    float right = info.gain[1];
+    const float delta_step = (wi->phase_delta_target-wi->phase_delta)/info.frame_count;
+    for(int i = 0;i<info.frame_count;++i) {
+        float samp = sinf(wi->phase);
+        wi->phase+=wi->phase_delta;
+        wi->phase_delta+=delta_step;
+        if(wi->phase>=player_two_pi) {
+            wi->phase-=player_two_pi;
+        }
+        if(info.channel_count==1) {
+            player_mix_store<Assign>(p++,samp*left);
+        } else {
+            player_mix_store<Assign>(p,samp*left);
+            player_mix_store<Assign>(p+1,samp*right);
+            p+=info.channel_count;
         }
+        left+=info.gain_step[0];
+        right+=info.gain_step[1];
     }
+    wi->phase_delta = wi->phase_delta_target;
+    return PLAYER_MIX_SOUND;
 }
-static void sqr_voice(const voice_function_info_t& info, void*state) {
+PLAYER_MIX_DISPATCH(sin_voice)
+template<bool Assign>
+static player_mix_result_t sqr_voice_mix(const mix_function_info_t& info, void*state) {
     waveform_info_t* wi = (waveform_info_t*)state; 
+    if(info.buffer==nullptr) {
+        player_waveform_skip(wi,info.frame_count);
+        return PLAYER_MIX_SILENT;
+    }
+    float* p = info.buffer;
+    float left = info.gain[0];
+    float right = info.gain[1];
+    const float delta_step = (wi->phase_delta_target-wi->phase_delta)/info.frame_count;
     for(int i = 0;i<info.frame_count;++i) {
         float f = ((wi->phase>player_pi)+1.0f)*.5f;
         wi->phase+=wi->phase_delta;
+        wi->phase_delta+=delta_step;
         if(wi->phase>=player_two_pi) {
             wi->phase-=player_two_pi;
         }
-        float samp = (f*wi->amplitude)*info.sample_max;
-        switch(info.bit_depth) {
-            case 8: {
-                uint8_t* p = ((uint8_t*)info.buffer)+(i*info.channel_count);
-                uint32_t tmp = *p+roundf(samp);
-                if(tmp>info.sample_max) {
-                    tmp = info.sample_max;
-                }
-                for(int j = 0;j<info.channel_count;++j) {
-                    *p++=tmp;
-                }
-            }
-            break;
-            case 16: {
-                uint16_t* p = ((uint16_t*)info.buffer)+(i*info.channel_count);
-                uint32_t tmp = *p+roundf(samp);
-                if(tmp>info.sample_max) {
-                    tmp = info.sample_max;
-                }
-                for(int j = 0;j<info.channel_count;++j) {
-                    *p++=tmp;
-                }
-            }
-            break;
-            default:
-            break;
+        float samp = f*2.0f-1.0f;
+        if(info.channel_count==1) {
+            player_mix_store<Assign>(p++,samp*left);
+        } else {
+            player_mix_store<Assign>(p,samp*left);
+            player_mix_store<Assign>(p+1,samp*right);
+            p+=info.channel_count;
         }
+        left+=info.gain_step[0];
+        right+=info.gain_step[1];
     }    
+    wi->phase_delta = wi->phase_delta_target;
+    return PLAYER_MIX_SOUND;
 }
-
-static void saw_voice(const voice_function_info_t& info, void*state) {
+PLAYER_MIX_DISPATCH(sqr_voice)
+// saw and tri bounce the phase between -pi and pi, so the sign of
+// phase_delta is the direction and the target is its magnitude
+template<bool Assign>
+static player_mix_result_t saw_voice_mix(const mix_function_info_t& info, void*state) {
     waveform_info_t* wi = (waveform_info_t*)state;
+    if(info.buffer==nullptr) {
+        player_waveform_bounce_skip(wi,info.frame_count);
+        return PLAYER_MIX_SILENT;
+    }
+    float* p = info.buffer;
+    float left = info.gain[0];
+    float right = info.gain[1];
+    float delta_step = (copysignf(wi->phase_delta_target,wi->phase_delta)-wi->phase_delta)/info.frame_count;
     for(int i = 0;i<info.frame_count;++i) {
         float f = (wi->phase>=0.0f);
         if (wi->phase + wi->phase_delta <= -(player_pi) || wi->phase + wi->phase_delta >= (player_pi)) {
             wi->phase_delta=-wi->phase_delta;
+            delta_step=-delta_step;
         }
         wi->phase+=wi->phase_delta;
-        float samp = (f*wi->amplitude)*info.sample_max;
-        switch(info.bit_depth) {
-            case 8: {
-                uint8_t* p = ((uint8_t*)info.buffer)+(i*info.channel_count);
-                uint32_t tmp = *p+roundf(samp);
-                if(tmp>info.sample_max) {
-                    tmp = info.sample_max;
-                }
-                for(int j = 0;j<info.channel_count;++j) {
-                    *p++=tmp;
-                }
-            }
-            break;
-            case 16: {
-                uint16_t* p = ((uint16_t*)info.buffer)+(i*info.channel_count);
-                uint32_t tmp = *p+roundf(samp);
-                if(tmp>info.sample_max) {
-                    tmp = info.sample_max;
-                }
-                for(int j = 0;j<info.channel_count;++j) {
-                    *p++=tmp;
-                }
-            }
-            break;
-            default:
-            break;
+        wi->phase_delta+=delta_step;
+        float samp = f*2.0f-1.0f;
+        if(info.channel_count==1) {
+            player_mix_store<Assign>(p++,samp*left);
+        } else {
+            player_mix_store<Assign>(p,samp*left);
+            player_mix_store<Assign>(p+1,samp*right);
+            p+=info.channel_count;
         }
+        left+=info.gain_step[0];
+        right+=info.gain_step[1];
     }
+    wi->phase_delta = copysignf(wi->phase_delta_target,wi->phase_delta);
+    return PLAYER_MIX_SOUND;
 }
-static void tri_voice(const voice_function_info_t& info, void*state) {
+PLAYER_MIX_DISPATCH(saw_voice)
+template<bool Assign>
+static player_mix_result_t tri_voice_mix(const mix_function_info_t& info, void*state) {
     waveform_info_t* wi = (waveform_info_t*)state;
+    if(info.buffer==nullptr) {
+        player_waveform_bounce_skip(wi,info.frame_count);
+        return PLAYER_MIX_SILENT;
+    }
+    float* p = info.buffer;
+    float left = info.gain[0];
+    float right = info.gain[1];
+    float delta_step = (copysignf(wi->phase_delta_target,wi->phase_delta)-wi->phase_delta)/info.frame_count;
     for(int i = 0;i<info.frame_count;++i) {
         float f = ((wi->phase / (player_pi)) + 1.0f) * .5f;
         if (wi->phase + wi->phase_delta <= -(player_pi) || wi->phase + wi->phase_delta >= (player_pi)) {
             wi->phase_delta=-wi->phase_delta;
+            delta_step=-delta_step;
         }
         wi->phase+=wi->phase_delta;
-        float samp = (f*wi->amplitude)*info.sample_max;
-                switch(info.bit_depth) {
-            case 8: {
-                uint8_t* p = ((uint8_t*)info.buffer)+(i*info.channel_count);
-                uint32_t tmp = *p+roundf(samp);
-                if(tmp>info.sample_max) {
-                    tmp = info.sample_max;
-                }
-                for(int j = 0;j<info.channel_count;++j) {
-                    *p++=tmp;
-                }
-            }
-            break;
-            case 16: {
-                uint16_t* p = ((uint16_t*)info.buffer)+(i*info.channel_count);
-                uint32_t tmp = *p+roundf(samp);
-                if(tmp>info.sample_max) {
-                    tmp = info.sample_max;
-                }
-                for(int j = 0;j<info.channel_count;++j) {
-                    *p++=tmp;
-                }
-            }
-            break;
-            default:
-            break;
+        wi->phase_delta+=delta_step;
+        float samp = f*2.0f-1.0f;
+        if(info.channel_count==1) {
+            player_mix_store<Assign>(p++,samp*left);
+        } else {
+            player_mix_store<Assign>(p,samp*left);
+            player_mix_store<Assign>(p+1,samp*right);
+            p+=info.channel_count;
         }
+        left+=info.gain_step[0];
+        right+=info.gain_step[1];
     }
+    wi->phase_delta = copysignf(wi->phase_delta_target,wi->phase_delta);
+    return PLAYER_MIX_SOUND;
 }
-static void wav_voice_16_2_to_16_2(const voice_function_info_t& info, void*state) {
-    wav_info_t* wi = (wav_info_t*)state;
-    if(!wi->loop&&wi->pos>=wi->length) {
-        return;
+PLAYER_MIX_DISPATCH(tri_voice)
+// the wav voices mix normalized samples into the float bus
+// so they work for any output bit depth
+constexpr static const float player_wav_scale = 1.0f/32768.0f;
+// advances a wav over a block without producing it, seeking past the
+// data when the stream can seek, and reading through it otherwise
+static player_mix_result_t player_wav_skip(wav_info_t* wi, size_t frame_count) {
+    unsigned long long bytes = (unsigned long long)frame_count*wi->channel_count*2;
+    if(wi->length==0) {
+        return PLAYER_MIX_DONE;
     }
-    uint16_t* dst = (uint16_t*)info.buffer;
-    for(int i = 0;i<info.frame_count;++i) {
-        int16_t i16;
-        
-        if(wi->pos>=wi->length) {
-            if(!wi->loop) {
-                break;
+    if(wi->on_seek_stream==nullptr) {
+        while(bytes--) {
+            if(wi->pos>=wi->length || 0>wi->on_read_stream(wi->on_read_stream_state)) {
+                return PLAYER_MIX_DONE;
             }
-            wi->on_seek_stream(wi->start,wi->on_seek_stream_state);
-            wi->pos = 0;
+            ++wi->pos;
         }
-        for(int j=0;j<info.channel_count;++j) {
-            if(player_read16s(wi->on_read_stream,wi->on_read_stream_state,&i16)) {
-                wi->pos+=2;
-            } else {
-                break;
-            }
-            *dst+=(uint16_t)(((i16*wi->amplitude)+32768U));
-            ++dst;
+        return wi->pos<wi->length?PLAYER_MIX_SILENT:PLAYER_MIX_DONE;
+    }
+    wi->pos+=bytes;
+    if(wi->pos>=wi->length) {
+        if(!wi->loop) {
+            return PLAYER_MIX_DONE;
         }
+        wi->pos%=wi->length;
     }
+    wi->on_seek_stream(wi->start+wi->pos,wi->on_seek_stream_state);
+    return PLAYER_MIX_SILENT;
 }
-static void wav_voice_16_2_to_8_1(const voice_function_info_t& info, void*state) {
+template<bool Assign>
+static player_mix_result_t wav_voice_16_2_to_2_mix(const mix_function_info_t& info, void*state) {
     wav_info_t* wi = (wav_info_t*)state;
+    if(info.buffer==nullptr) {
+        return player_wav_skip(wi,info.frame_count);
+    }
+    float* dst = info.buffer;
+    const float* end = dst+info.frame_count*info.channel_count;
     if(!wi->loop&&wi->pos>=wi->length) {
-        return;
+        return player_mix_done<Assign>(dst,end);
     }
-    uint8_t* dst = (uint8_t*)info.buffer;
+    // ORs every sample so digital silence in the source is reported
+    int16_t any = 0;
+    float left = info.gain[0]*player_wav_scale;
+    float right = info.gain[1]*player_wav_scale;
+    const float left_step = info.gain_step[0]*player_wav_scale;
+    const float right_step = info.gain_step[1]*player_wav_scale;
     for(int i = 0;i<info.frame_count;++i) {
         int16_t i16;
+        
         if(wi->pos>=wi->length) {
             if(!wi->loop) {
-                break;
+                return player_mix_done<Assign>(dst,end);
             }
             wi->on_seek_stream(wi->start,wi->on_seek_stream_state);
             wi->pos = 0;
         }
-        
         if(player_read16s(wi->on_read_stream,wi->on_read_stream_state,&i16)) {
             wi->pos+=2;
+            any|=i16;
         } else {
-            return;
+            return player_mix_done<Assign>(dst,end);
         }
-        int32_t i32 = i16;
+        player_mix_store<Assign>(dst,i16*left);
         if(player_read16s(wi->on_read_stream,wi->on_read_stream_state,&i16)) {
             wi->pos+=2;
+            any|=i16;
         } else {
-            return;
+            return player_mix_done<Assign>(dst+1,end);
         }
-        i32+=i16;
-        i32>>=1;
-        *dst+=(uint8_t)((((int32_t)(i32*wi->amplitude+0.5f)+32768U)>>8));
-        ++dst;
+        player_mix_store<Assign>(dst+1,i16*right);
+        dst+=2;
+        left+=left_step;
+        right+=right_step;
+    }
+    if(!wi->loop && wi->pos>=wi->length) {
+        return PLAYER_MIX_DONE;
     }
+    return any?PLAYER_MIX_SOUND:PLAYER_MIX_SILENT;
 }
-static void wav_voice_16_1_to_16_2(const voice_function_info_t& info, void*state) {
+PLAYER_MIX_DISPATCH(wav_voice_16_2_to_2)
+template<bool Assign>
+static player_mix_result_t wav_voice_16_1_to_2_mix(const mix_function_info_t& info, void*state) {
     wav_info_t* wi = (wav_info_t*)state;
+    if(info.buffer==nullptr) {
+        return player_wav_skip(wi,info.frame_count);
+    }
+    float* dst = info.buffer;
+    const float* end = dst+info.frame_count*info.channel_count;
     if(!wi->loop&&wi->pos>=wi->length) {
-        return;
+        return player_mix_done<Assign>(dst,end);
     }
-    uint16_t* dst = (uint16_t*)info.buffer;
+    // ORs every sample so digital silence in the source is reported
+    int16_t any = 0;
+    float left = info.gain[0]*player_wav_scale;
+    float right = info.gain[1]*player_wav_scale;
+    const float left_step = info.gain_step[0]*player_wav_scale;
+    const float right_step = info.gain_step[1]*player_wav_scale;
     for(int i = 0;i<info.frame_count;++i) {
         int16_t i16;
         if(wi->pos>=wi->length) {
             if(!wi->loop) {
-                break;
+                return player_mix_done<Assign>(dst,end);
             }
             wi->on_seek_stream(wi->start,wi->on_seek_stream_state);
             wi->pos = 0;
         }
         if(player_read16s(wi->on_read_stream,wi->on_read_stream_state,&i16)) {
             wi->pos+=2;
+            any|=i16;
         } else {
-            break;
-        }
-        uint16_t u16 = (uint16_t)(((int16_t)(i16*wi->amplitude+0.5f)+32768U));
-        for(int j=0;j<info.channel_count;++j) {
-            *dst+=u16;
-            ++dst;
+            return player_mix_done<Assign>(dst,end);
         }
+        player_mix_store<Assign>(dst++,i16*left);
+        player_mix_store<Assign>(dst++,i16*right);
+        left+=left_step;
+        right+=right_step;
+    }
+    if(!wi->loop && wi->pos>=wi->length) {
+        return PLAYER_MIX_DONE;
     }
+    return any?PLAYER_MIX_SOUND:PLAYER_MIX_SILENT;
 }
-static void wav_voice_16_2_to_16_1(const voice_function_info_t& info, void*state) {
+PLAYER_MIX_DISPATCH(wav_voice_16_1_to_2)
+template<bool Assign>
+static player_mix_result_t wav_voice_16_2_to_1_mix(const mix_function_info_t& info, void*state) {
     wav_info_t* wi = (wav_info_t*)state;
+    if(info.buffer==nullptr) {
+        return player_wav_skip(wi,info.frame_count);
+    }
+    float* dst = info.buffer;
+    const float* end = dst+info.frame_count*info.channel_count;
     if(!wi->loop&&wi->pos>=wi->length) {
-        return;
+        return player_mix_done<Assign>(dst,end);
     }
-    uint16_t* dst = (uint16_t*)info.buffer;
+    // ORs every sample so digital silence in the source is reported
+    int16_t any = 0;
+    float gain = info.gain[0]*player_wav_scale;
+    const float gain_step = info.gain_step[0]*player_wav_scale;
     for(int i = 0;i<info.frame_count;++i) {
         int16_t i16;
         if(wi->pos>=wi->length) {
             if(!wi->loop) {
-                break;
+                return player_mix_done<Assign>(dst,end);
             }
             wi->on_seek_stream(wi->start,wi->on_seek_stream_state);
             wi->pos = 0;
@@ -377,154 +1020,651 @@ static void wav_voice_16_2_to_16_1(const voice_function_info_t& info, void*state
         
         if(player_read16s(wi->on_read_stream,wi->on_read_stream_state,&i16)) {
             wi->pos+=2;
+            any|=i16;
         } else {
-            return;
+            return player_mix_done<Assign>(dst,end);
         }
         int32_t i32 = i16;
         if(player_read16s(wi->on_read_stream,wi->on_read_stream_state,&i16)) {
             wi->pos+=2;
+            any|=i16;
         } else {
-            return;
+            return player_mix_done<Assign>(dst,end);
         }
         i32+=i16;
         i32>>=1;
-        *dst+=(uint8_t)(((int32_t)(i32*wi->amplitude+0.5f)+32768U));
+        player_mix_store<Assign>(dst,i32*gain);
+        gain+=gain_step;
         ++dst;
     }
+    if(!wi->loop && wi->pos>=wi->length) {
+        return PLAYER_MIX_DONE;
+    }
+    return any?PLAYER_MIX_SOUND:PLAYER_MIX_SILENT;
 }
-static void wav_voice_16_1_to_16_1(const voice_function_info_t& info, void*state) {
+PLAYER_MIX_DISPATCH(wav_voice_16_2_to_1)
+template<bool Assign>
+static player_mix_result_t wav_voice_16_1_to_1_mix(const mix_function_info_t& info, void*state) {
     wav_info_t* wi = (wav_info_t*)state;
+    if(info.buffer==nullptr) {
+        return player_wav_skip(wi,info.frame_count);
+    }
+    float* dst = info.buffer;
+    const float* end = dst+info.frame_count*info.channel_count;
     if(!wi->loop&&wi->pos>=wi->length) {
-        return;
+        return player_mix_done<Assign>(dst,end);
     }
-    uint16_t* dst = (uint16_t*)info.buffer;
+    // ORs every sample so digital silence in the source is reported
+    int16_t any = 0;
+    float gain = info.gain[0]*player_wav_scale;
+    const float gain_step = info.gain_step[0]*player_wav_scale;
     for(int i = 0;i<info.frame_count;++i) {
         int16_t i16;
         if(wi->pos>=wi->length) {
             if(!wi->loop) {
-                break;
+                return player_mix_done<Assign>(dst,end);
             }
             wi->on_seek_stream(wi->start,wi->on_seek_stream_state);
             wi->pos = 0;
         }
         if(player_read16s(wi->on_read_stream,wi->on_read_stream_state,&i16)) {
             wi->pos+=2;
+            any|=i16;
         } else {
-            break;
+            return player_mix_done<Assign>(dst,end);
         }
-        uint16_t u16 = (uint16_t)(((int16_t)(i16*wi->amplitude+0.5f)+32768U));
-        *dst+=u16;
+        player_mix_store<Assign>(dst,i16*gain);
+        gain+=gain_step;
         ++dst;
     }
+    if(!wi->loop && wi->pos>=wi->length) {
+        return PLAYER_MIX_DONE;
+    }
+    return any?PLAYER_MIX_SOUND:PLAYER_MIX_SILENT;
 }
-
-static void wav_voice_16_1_to_8_1(const voice_function_info_t& info, void*state) {
-    wav_info_t* wi = (wav_info_t*)state;
-    if(!wi->loop&&wi->pos>=wi->length) {
-        return;
+PLAYER_MIX_DISPATCH(wav_voice_16_1_to_1)
+// a signed 8-bit sample played from memory at a fractional rate
+typedef struct sample_info {
+    const int8_t* data;
+    // the end of the sample, or of the loop when it loops
+    unsigned long length;
+    unsigned long loop_start;
+    // the sample loops when this isn't zero
+    unsigned long loop_length;
+    // the position and the per frame step in samples, as 32.32 fixed point
+    unsigned long long pos;
+    unsigned long long step;
+} sample_info_t;
+constexpr static const float player_sample_scale = 1.0f/128.0f;
+constexpr static const float player_sample_fraction_scale = 1.0f/4294967296.0f;
+// wraps the position back into the loop. returns false once a sample
+// that doesn't loop has ended
+static bool player_sample_wrap(sample_info_t* si) {
+    if(si->pos<((unsigned long long)si->length<<32)) {
+        return true;
+    }
+    if(si->loop_length==0) {
+        return false;
+    }
+    const unsigned long long loop_start = (unsigned long long)si->loop_start<<32;
+    si->pos = loop_start+(si->pos-loop_start)%((unsigned long long)si->loop_length<<32);
+    return true;
+}
+template<bool Assign>
+static player_mix_result_t sample_voice_mix(const mix_function_info_t& info, void*state) {
+    sample_info_t* si = (sample_info_t*)state;
+    if(info.buffer==nullptr) {
+        si->pos+=si->step*info.frame_count;
+        return player_sample_wrap(si)?PLAYER_MIX_SILENT:PLAYER_MIX_DONE;
     }
-    uint8_t* dst = (uint8_t*)info.buffer;
+    float* p = info.buffer;
+    const float* end = p+info.frame_count*info.channel_count;
+    float left = info.gain[0]*player_sample_scale;
+    float right = info.gain[1]*player_sample_scale;
+    const float left_step = info.gain_step[0]*player_sample_scale;
+    const float right_step = info.gain_step[1]*player_sample_scale;
     for(int i = 0;i<info.frame_count;++i) {
-        int16_t i16;
-        if(wi->pos>=wi->length) {
-            if(!wi->loop) {
-                break;
-            }
-            wi->on_seek_stream(wi->start,wi->on_seek_stream_state);
-            wi->pos = 0;
+        if(!player_sample_wrap(si)) {
+            return player_mix_done<Assign>(p,end);
         }
-        if(player_read16s(wi->on_read_stream,wi->on_read_stream_state,&i16)) {
-            wi->pos+=2;
+        // interpolate toward the next sample, which is the loop start at the end of a loop
+        const unsigned long index = (unsigned long)(si->pos>>32);
+        int next = 0;
+        if(index+1<si->length) {
+            next = si->data[index+1];
+        } else if(si->loop_length!=0) {
+            next = si->data[si->loop_start];
+        }
+        const float frac = (uint32_t)si->pos*player_sample_fraction_scale;
+        const float samp = si->data[index]+(next-si->data[index])*frac;
+        si->pos+=si->step;
+        if(info.channel_count==1) {
+            player_mix_store<Assign>(p++,samp*left);
         } else {
-            break;
+            player_mix_store<Assign>(p,samp*left);
+            player_mix_store<Assign>(p+1,samp*right);
+            p+=info.channel_count;
         }
-        uint8_t u8 = (uint8_t)((((int16_t)(i16*wi->amplitude+0.5f)+32768U)>>8));
-        *dst+=u8;
-        ++dst;
+        left+=left_step;
+        right+=right_step;
     }
+    return PLAYER_MIX_SOUND;
 }
-
-static voice_handle_t player_add_voice(unsigned char port, 
-                                        voice_handle_t* in_out_first, 
-                                        voice_function_t fn, 
-                                        void* fn_state, 
-                                        void*(allocator)(size_t)) {
-    voice_info_t* pnew;
-    if(*in_out_first==nullptr) {
-        pnew = (voice_info_t*)allocator(sizeof(voice_info_t));
-        if(pnew==nullptr) {
-            return nullptr;
-        }
-        pnew->port = port;
-        pnew->next = nullptr;
-        pnew->fn = fn;
-        pnew->fn_state = fn_state;
-        *in_out_first = pnew;
-        return pnew;
+PLAYER_MIX_DISPATCH(sample_voice)
+// one cycle of a sine wave, with the first entry repeated so the
+// lookup can interpolate without wrapping
+constexpr static const size_t player_sine_table_size = 256;
+static const float player_sine_table[player_sine_table_size+1] = {
+    0.0000000f,0.0245412f,0.0490677f,0.0735646f,0.0980171f,0.1224107f,0.1467305f,0.1709619f,
+    0.1950903f,0.2191012f,0.2429802f,0.2667128f,0.2902847f,0.3136817f,0.3368899f,0.3598950f,
+    0.3826834f,0.4052413f,0.4275551f,0.4496113f,0.4713967f,0.4928982f,0.5141027f,0.5349976f,
+    0.5555702f,0.5758082f,0.5956993f,0.6152316f,0.6343933f,0.6531728f,0.6715590f,0.6895405f,
+    0.7071068f,0.7242471f,0.7409511f,0.7572088f,0.7730105f,0.7883464f,0.8032075f,0.8175848f,
+    0.8314696f,0.8448536f,0.8577286f,0.8700870f,0.8819213f,0.8932243f,0.9039893f,0.9142098f,
+    0.9238795f,0.9329928f,0.9415441f,0.9495282f,0.9569403f,0.9637761f,0.9700313f,0.9757021f,
+    0.9807853f,0.9852776f,0.9891765f,0.9924795f,0.9951847f,0.9972905f,0.9987955f,0.9996988f,
+    1.0000000f,0.9996988f,0.9987955f,0.9972905f,0.9951847f,0.9924795f,0.9891765f,0.9852776f,
+    0.9807853f,0.9757021f,0.9700313f,0.9637761f,0.9569403f,0.9495282f,0.9415441f,0.9329928f,
+    0.9238795f,0.9142098f,0.9039893f,0.8932243f,0.8819213f,0.8700870f,0.8577286f,0.8448536f,
+    0.8314696f,0.8175848f,0.8032075f,0.7883464f,0.7730105f,0.7572088f,0.7409511f,0.7242471f,
+    0.7071068f,0.6895405f,0.6715590f,0.6531728f,0.6343933f,0.6152316f,0.5956993f,0.5758082f,
+    0.5555702f,0.5349976f,0.5141027f,0.4928982f,0.4713967f,0.4496113f,0.4275551f,0.4052413f,
+    0.3826834f,0.3598950f,0.3368899f,0.3136817f,0.2902847f,0.2667128f,0.2429802f,0.2191012f,
+    0.1950903f,0.1709619f,0.1467305f,0.1224107f,0.0980171f,0.0735646f,0.0490677f,0.0245412f,
+    0.0000000f,-0.0245412f,-0.0490677f,-0.0735646f,-0.0980171f,-0.1224107f,-0.1467305f,-0.1709619f,
+    -0.1950903f,-0.2191012f,-0.2429802f,-0.2667128f,-0.2902847f,-0.3136817f,-0.3368899f,-0.3598950f,
+    -0.3826834f,-0.4052413f,-0.4275551f,-0.4496113f,-0.4713967f,-0.4928982f,-0.5141027f,-0.5349976f,
+    -0.5555702f,-0.5758082f,-0.5956993f,-0.6152316f,-0.6343933f,-0.6531728f,-0.6715590f,-0.6895405f,
+    -0.7071068f,-0.7242471f,-0.7409511f,-0.7572088f,-0.7730105f,-0.7883464f,-0.8032075f,-0.8175848f,
+    -0.8314696f,-0.8448536f,-0.8577286f,-0.8700870f,-0.8819213f,-0.8932243f,-0.9039893f,-0.9142098f,
+    -0.9238795f,-0.9329928f,-0.9415441f,-0.9495282f,-0.9569403f,-0.9637761f,-0.9700313f,-0.9757021f,
+    -0.9807853f,-0.9852776f,-0.9891765f,-0.9924795f,-0.9951847f,-0.9972905f,-0.9987955f,-0.9996988f,
+    -1.0000000f,-0.9996988f,-0.9987955f,-0.9972905f,-0.9951847f,-0.9924795f,-0.9891765f,-0.9852776f,
+    -0.9807853f,-0.9757021f,-0.9700313f,-0.9637761f,-0.9569403f,-0.9495282f,-0.9415441f,-0.9329928f,
+    -0.9238795f,-0.9142098f,-0.9039893f,-0.8932243f,-0.8819213f,-0.8700870f,-0.8577286f,-0.8448536f,
+    -0.8314696f,-0.8175848f,-0.8032075f,-0.7883464f,-0.7730105f,-0.7572088f,-0.7409511f,-0.7242471f,
+    -0.7071068f,-0.6895405f,-0.6715590f,-0.6531728f,-0.6343933f,-0.6152316f,-0.5956993f,-0.5758082f,
+    -0.5555702f,-0.5349976f,-0.5141027f,-0.4928982f,-0.4713967f,-0.4496113f,-0.4275551f,-0.4052413f,
+    -0.3826834f,-0.3598950f,-0.3368899f,-0.3136817f,-0.2902847f,-0.2667128f,-0.2429802f,-0.2191012f,
+    -0.1950903f,-0.1709619f,-0.1467305f,-0.1224107f,-0.0980171f,-0.0735646f,-0.0490677f,-0.0245412f,
+    0.0000000f
+};
+// looks up the sine of a 32-bit phase, where 2^32 is a full cycle
+static inline float player_sine(uint32_t phase) {
+    const uint32_t i = phase>>24;
+    const float frac = (phase&0xFFFFFF)*(1.0f/16777216.0f);
+    return player_sine_table[i]+(player_sine_table[i+1]-player_sine_table[i])*frac;
+}
+// converts radians to 32-bit phase
+constexpr static const float player_fm_phase_scale = 4294967296.0f/(2.0f*PI);
+// voices that render in several passes, like FM voices one operator at a
+// time, work through the block a chunk of frames at a time
+constexpr static const size_t player_chunk_frames = 64;
+typedef struct fm_info {
+    float frequency;
+    size_t operator_count;
+    float ratio[PLAYER_FM_OPERATORS];
+    float index[PLAYER_FM_OPERATORS];
+    uint32_t phase[PLAYER_FM_OPERATORS];
+    uint32_t phase_delta[PLAYER_FM_OPERATORS];
+    envelope_info_t envelopes[PLAYER_FM_OPERATORS];
+} fm_info_t;
+static void player_fm_frequency(fm_info_t* fi, float frequency, unsigned int sample_rate) {
+    fi->frequency = frequency;
+    for(size_t i = 0;i<fi->operator_count;++i) {
+        fi->phase_delta[i] = (uint32_t)(unsigned long long)((double)frequency*fi->ratio[i]/sample_rate*4294967296.0);
     }
-    voice_info_t* v = (voice_info_t*)*in_out_first;
-    if(v->port>port) {
-        pnew = (voice_info_t*)allocator(sizeof(voice_info_t));
-        if(pnew==nullptr) {
-            return nullptr;
+}
+// operator 0 is the carrier, and each operator modulates the one below it
+template<bool Assign>
+static player_mix_result_t fm_voice_mix(const mix_function_info_t& info, void*state) {
+    fm_info_t* fi = (fm_info_t*)state;
+    const size_t ops = fi->operator_count;
+    float level[PLAYER_FM_OPERATORS];
+    float level_step[PLAYER_FM_OPERATORS];
+    for(size_t j = 0;j<ops;++j) {
+        level[j] = fi->envelopes[j].level*fi->index[j];
+        level_step[j] = (player_envelope_advance(&fi->envelopes[j],info.frame_count)*fi->index[j]-level[j])/info.frame_count;
+    }
+    const bool done = fi->envelopes[0].stage==PLAYER_ENVELOPE_DONE;
+    if(info.buffer==nullptr) {
+        for(size_t j = 0;j<ops;++j) {
+            fi->phase[j]+=(uint32_t)(fi->phase_delta[j]*info.frame_count);
         }
-        pnew->port = port;
-        pnew->next = v;
-        pnew->fn = fn;
-        pnew->fn_state = fn_state;
-        *in_out_first = pnew;
-        return pnew;
+        return done?PLAYER_MIX_DONE:PLAYER_MIX_SILENT;
     }
-    while(v->next!=nullptr && v->next->port<=port) {
-        v=v->next;
+    float* p = info.buffer;
+    float left = info.gain[0];
+    float right = info.gain[1];
+    float mod[player_chunk_frames];
+    for(size_t start = 0;start<info.frame_count;start+=player_chunk_frames) {
+        const size_t count = info.frame_count-start<player_chunk_frames?info.frame_count-start:player_chunk_frames;
+        // the top operator has nothing modulating it
+        for(int i = 0;i<(int)count;++i) {
+            mod[i] = 0.0f;
+        }
+        for(size_t j = ops;j-->0;) {
+            uint32_t phase = fi->phase[j];
+            const uint32_t delta = fi->phase_delta[j];
+            float lvl = level[j];
+            const float lvl_step = level_step[j];
+            // modulators are scaled to radians of phase for the next operator
+            const float scale = j==0?1.0f:player_fm_phase_scale;
+            for(int i = 0;i<(int)count;++i) {
+                const uint32_t offset = (uint32_t)(long long)mod[i];
+                mod[i] = player_sine(phase+offset)*lvl*scale;
+                phase+=delta;
+                lvl+=lvl_step;
+            }
+            fi->phase[j] = phase;
+            level[j] = lvl;
+        }
+        for(int i = 0;i<(int)count;++i) {
+            if(info.channel_count==1) {
+                player_mix_store<Assign>(p++,mod[i]*left);
+            } else {
+                player_mix_store<Assign>(p,mod[i]*left);
+                player_mix_store<Assign>(p+1,mod[i]*right);
+                p+=info.channel_count;
+            }
+            left+=info.gain_step[0];
+            right+=info.gain_step[1];
+        }
+    }
+    return done?PLAYER_MIX_DONE:PLAYER_MIX_SOUND;
+}
+PLAYER_MIX_DISPATCH(fm_voice)
+// noise is generated by interleaved xorshift generators that
+// run independently, so a chunk of it can be computed in parallel
+constexpr static const size_t player_noise_lanes = 16;
+typedef struct noise_info {
+    player_noise_t type;
+    uint32_t state[player_noise_lanes];
+    // the pink filter's poles and the brown integrator
+    float b0, b1, b2;
+    float brown;
+} noise_info_t;
+constexpr static const float player_noise_scale = 1.0f/2147483648.0f;
+template<bool Assign>
+static player_mix_result_t noise_voice_mix(const mix_function_info_t& info, void*state) {
+    noise_info_t* ni = (noise_info_t*)state;
+    if(info.buffer==nullptr) {
+        return PLAYER_MIX_SILENT;
+    }
+    float* p = info.buffer;
+    float left = info.gain[0];
+    float right = info.gain[1];
+    float chunk[player_chunk_frames];
+    uint32_t x[player_noise_lanes];
+    for(size_t k = 0;k<player_noise_lanes;++k) {
+        x[k] = ni->state[k];
+    }
+    for(size_t start = 0;start<info.frame_count;start+=player_chunk_frames) {
+        const size_t count = info.frame_count-start<player_chunk_frames?info.frame_count-start:player_chunk_frames;
+        // a whole chunk is generated even if only part of it is used
+        for(size_t i = 0;i<player_chunk_frames;i+=player_noise_lanes) {
+            float* dst = chunk+i;
+            for(int k = 0;k<(int)player_noise_lanes;++k) {
+                uint32_t v = x[k];
+                v^=v<<13;
+                v^=v>>17;
+                v^=v<<5;
+                x[k] = v;
+                dst[k] = (int32_t)v*player_noise_scale;
+            }
+        }
+        if(ni->type==PLAYER_NOISE_PINK) {
+            // Paul Kellet's economy pink filter
+            float b0 = ni->b0, b1 = ni->b1, b2 = ni->b2;
+            for(int i = 0;i<(int)count;++i) {
+                const float w = chunk[i];
+                b0 = .99765f*b0+w*.0990460f;
+                b1 = .96300f*b1+w*.2965164f;
+                b2 = .57000f*b2+w*1.0526913f;
+                chunk[i] = (b0+b1+b2+w*.1848f)*.11f;
+            }
+            ni->b0 = b0;
+            ni->b1 = b1;
+            ni->b2 = b2;
+        } else if(ni->type==PLAYER_NOISE_BROWN) {
+            // a leaky integrator keeps brown noise from wandering off
+            float brown = ni->brown;
+            for(int i = 0;i<(int)count;++i) {
+                brown = (brown+.02f*chunk[i])*(1.0f/1.02f);
+                chunk[i] = brown*3.5f;
+            }
+            ni->brown = brown;
+        }
+        for(int i = 0;i<(int)count;++i) {
+            if(info.channel_count==1) {
+                player_mix_store<Assign>(p++,chunk[i]*left);
+            } else {
+                player_mix_store<Assign>(p,chunk[i]*left);
+                player_mix_store<Assign>(p+1,chunk[i]*right);
+                p+=info.channel_count;
+            }
+            left+=info.gain_step[0];
+            right+=info.gain_step[1];
+        }
+    }
+    for(size_t k = 0;k<player_noise_lanes;++k) {
+        ni->state[k] = x[k];
+    }
+    return PLAYER_MIX_SOUND;
+}
+PLAYER_MIX_DISPATCH(noise_voice)
+// gets the wav state of a voice, or null if it isn't a wav voice
+static const wav_info_t* player_voice_wav(const voice_info_t* v) {
+    if(v->mix_fn==wav_voice_16_2_to_2 || v->mix_fn==wav_voice_16_1_to_2 ||
+        v->mix_fn==wav_voice_16_2_to_1 || v->mix_fn==wav_voice_16_1_to_1) {
+        return (const wav_info_t*)v->fn_state;
+    }
+    return nullptr;
+}
+// adds or stores the output format samples a custom voice produced to the float bus
+template<bool Assign>
+static void player_pcm_to_mix(const void* src, 
+                            float* dst, 
+                            const mix_function_info_t& info, 
+                            unsigned int bit_depth) {
+    float left = info.gain[0];
+    float right = info.gain[1];
+    switch(bit_depth) {
+        case 8: {
+            const uint8_t* p = (const uint8_t*)src;
+            left*=(1.0f/128.0f);
+            right*=(1.0f/128.0f);
+            const float left_step = info.gain_step[0]*(1.0f/128.0f);
+            const float right_step = info.gain_step[1]*(1.0f/128.0f);
+            for(size_t i = 0;i<info.frame_count;++i) {
+                player_mix_store<Assign>(dst++,((int32_t)*p++-128)*left);
+                for(int j = 1;j<info.channel_count;++j) {
+                    player_mix_store<Assign>(dst++,((int32_t)*p++-128)*right);
+                }
+                left+=left_step;
+                right+=right_step;
+            }
+        }
+        break;
+        case 16: {
+            const uint16_t* p = (const uint16_t*)src;
+            left*=(1.0f/32768.0f);
+            right*=(1.0f/32768.0f);
+            const float left_step = info.gain_step[0]*(1.0f/32768.0f);
+            const float right_step = info.gain_step[1]*(1.0f/32768.0f);
+            for(size_t i = 0;i<info.frame_count;++i) {
+                player_mix_store<Assign>(dst++,((int32_t)*p++-32768)*left);
+                for(int j = 1;j<info.channel_count;++j) {
+                    player_mix_store<Assign>(dst++,((int32_t)*p++-32768)*right);
+                }
+                left+=left_step;
+                right+=right_step;
+            }
+        }
+        break;
+        default:
+        break;
+    }
+}
+// the size of a sample in the output buffer, in bits
+static unsigned short player_format_bit_depth(player_format_t format) {
+    switch(format) {
+        case PLAYER_FORMAT_U8:
+            return 8;
+        case PLAYER_FORMAT_U16:
+        case PLAYER_FORMAT_S16:
+            return 16;
+        default:
+            return 32;
+    }
+}
+// custom voices render unsigned 8-bit for 8-bit output, 
+// and unsigned 16-bit for everything else
+static unsigned short player_voice_bit_depth(player_format_t format) {
+    return format==PLAYER_FORMAT_U8?8:16;
+}
+// the largest magnitude in a float buffer. non negative floats order the
+// same as their bits, so this is an integer max, which vectorizes
+static float player_peak(const float* buffer, size_t sample_count) {
+    uint32_t peak = 0;
+    for(size_t i = 0;i<sample_count;++i) {
+        uint32_t bits;
+        memcpy(&bits,buffer+i,sizeof(bits));
+        bits&=0x7FFFFFFFU;
+        peak = bits>peak?bits:peak;
+    }
+    float result;
+    memcpy(&result,&peak,sizeof(result));
+    return result;
+}
+// mixes one float bus into another with a gain, storing if the
+// destination hasn't been written yet this block
+static void player_bus_add(float* dst, const float* src, size_t sample_count, float gain, bool assign) {
+    if(assign) {
+        for(size_t i = 0;i<sample_count;++i) {
+            dst[i]=src[i]*gain;
+        }
+    } else {
+        for(size_t i = 0;i<sample_count;++i) {
+            dst[i]+=src[i]*gain;
+        }
+    }
+}
+// mixes a port bus down to mono into the effects send
+static void player_send_add(float* dst, const float* src, size_t frame_count, unsigned int channel_count, float gain, bool assign) {
+    if(channel_count==1) {
+        player_bus_add(dst,src,frame_count,gain,assign);
+        return;
+    }
+    gain*=.5f;
+    for(size_t i = 0;i<frame_count;++i) {
+        const float f = (src[0]+src[1])*gain;
+        dst[i] = assign?f:dst[i]+f;
+        src+=channel_count;
+    }
+}
+// fills an output format buffer with the level the mixer produces for zero
+static void player_fill_silence(void* dst, size_t sample_count, player_format_t format) {
+    switch(format) {
+        case PLAYER_FORMAT_U8:
+            memset(dst,128,sample_count);
+            break;
+        case PLAYER_FORMAT_U16: {
+            uint16_t* p = (uint16_t*)dst;
+            for(size_t i = 0;i<sample_count;++i) {
+                *p++=32768;
+            }
+        }
+        break;
+        default:
+            memset(dst,0,sample_count*(player_format_bit_depth(format)/8));
+            break;
+    }
+}
+// converts the float mix to the output format, clamping instead of wrapping.
+// the loops are kept branch free so the compiler can vectorize them. the 
+// integer formats round by offsetting to unsigned first, so signed 16-bit 
+// is always the unsigned output with the sign bit flipped
+static void player_mix_to_pcm(const float* src, void* dst, size_t sample_count, player_format_t format) {
+    switch(format) {
+        case PLAYER_FORMAT_U8: {
+            uint8_t* p = (uint8_t*)dst;
+            for(size_t i = 0;i<sample_count;++i) {
+                float f = src[i]*128.0f+128.5f;
+                f = f<0.0f?0.0f:f;
+                f = f>255.0f?255.0f:f;
+                p[i]=(uint8_t)f;
+            }
+        }
+        break;
+        case PLAYER_FORMAT_U16: {
+            uint16_t* p = (uint16_t*)dst;
+            for(size_t i = 0;i<sample_count;++i) {
+                float f = src[i]*32768.0f+32768.5f;
+                f = f<0.0f?0.0f:f;
+                f = f>65535.0f?65535.0f:f;
+                p[i]=(uint16_t)f;
+            }
+        }
+        break;
+        case PLAYER_FORMAT_S16: {
+            int16_t* p = (int16_t*)dst;
+            for(size_t i = 0;i<sample_count;++i) {
+                float f = src[i]*32768.0f+32768.5f;
+                f = f<0.0f?0.0f:f;
+                f = f>65535.0f?65535.0f:f;
+                p[i]=(int16_t)((int32_t)f-32768);
+            }
+        }
+        break;
+        case PLAYER_FORMAT_S24_32: {
+            int32_t* p = (int32_t*)dst;
+            for(size_t i = 0;i<sample_count;++i) {
+                float f = src[i]*8388608.0f+8388608.5f;
+                f = f<0.0f?0.0f:f;
+                f = f>16777215.0f?16777215.0f:f;
+                p[i]=(int32_t)f-8388608;
+            }
+        }
+        break;
+        case PLAYER_FORMAT_S32: {
+            int32_t* p = (int32_t*)dst;
+            for(size_t i = 0;i<sample_count;++i) {
+                // rounds like the offset in the other formats. a float offset
+                // by 2^31 would lose its bottom bits, so this uses floorf
+                float f = floorf(src[i]*2147483648.0f+.5f);
+                f = f<-2147483648.0f?-2147483648.0f:f;
+                // the largest float below 2^31
+                f = f>2147483520.0f?2147483520.0f:f;
+                p[i]=(int32_t)f;
+            }
+        }
+        break;
+        case PLAYER_FORMAT_F32: {
+            float* p = (float*)dst;
+            for(size_t i = 0;i<sample_count;++i) {
+                float f = src[i];
+                f = f<-1.0f?-1.0f:f;
+                f = f>1.0f?1.0f:f;
+                p[i]=f;
+            }
+        }
+        break;
+        default:
+        break;
     }
-    voice_info_t* vnext = v->next;
-    pnew = (voice_info_t*)allocator(sizeof(voice_info_t));
+}
+
+static voice_handle_t player_add_voice(unsigned short port, 
+                                        voice_handle_t* in_out_first, 
+                                        voice_function_t fn, 
+                                        mix_function_t mix_fn,
+                                        void* fn_state, 
+                                        float gain,
+                                        void*(allocator)(size_t)) {
+    voice_info_t* pnew = (voice_info_t*)allocator(sizeof(voice_info_t));
     if(pnew==nullptr) {
         return nullptr;
     }
     pnew->port = port;
-    pnew->next = vnext;
     pnew->fn = fn;
+    pnew->mix_fn = mix_fn;
     pnew->fn_state = fn_state;
+    pnew->gain = gain;
+    pnew->gain_target = gain;
+    pnew->pan = 0.0f;
+    pnew->pan_target = 0.0f;
+    pnew->envelope = nullptr;
+    pnew->filters = nullptr;
+    pnew->start = 0;
+    pnew->stop = player_never;
+    pnew->played = 0;
+    pnew->pooled = false;
+    pnew->finished = false;
+    pnew->on_finished = nullptr;
+    pnew->on_finished_state = nullptr;
+#ifdef PLAYER_INSTRUMENTATION
+    player_timing_reset(&pnew->timing);
+#endif
+    voice_info_t* v = (voice_info_t*)*in_out_first;
+    if(v==nullptr || v->port>port) {
+        pnew->next = v;
+        *in_out_first = pnew;
+        return pnew;
+    }
+    while(v->next!=nullptr && v->next->port<=port) {
+        v=v->next;
+    }
+    pnew->next = v->next;
     v->next = pnew;
-   return v;
+    return pnew;
+}
+static voice_info_t* player_find_voice(voice_handle_t first, voice_handle_t handle) {
+    voice_info_t* v = (voice_info_t*)first;
+    while(v!=nullptr && v!=handle) {
+        v=v->next;
+    }
+    return v;
+}
+static bool player_is_waveform(const voice_info_t* v) {
+    return v->mix_fn==sin_voice || 
+        v->mix_fn==sqr_voice || 
+        v->mix_fn==saw_voice || 
+        v->mix_fn==tri_voice;
+}
+static void player_free_voice(voice_info_t* v, void(deallocator)(void*)) {
+    if(v->fn_state!=nullptr) {
+        deallocator(v->fn_state);
+    }
+    if(v->envelope!=nullptr) {
+        deallocator(v->envelope);
+    }
+    if(v->filters!=nullptr) {
+        deallocator(v->filters);
+    }
+    deallocator(v);
 }
 static bool player_remove_voice(voice_handle_t* in_out_first,
                                 voice_handle_t handle,
                                 void(deallocator)(void*)) {
     voice_info_t** pv = (voice_info_t**)in_out_first;
+    while(*pv!=nullptr && *pv!=handle) {
+        pv=&(*pv)->next;
+    }
     voice_info_t* v = *pv;
-    if(v==nullptr) {return false;}
-    if(handle==v) {
-        *pv = v->next;
-        if(v->fn_state!=nullptr) {
-            deallocator(v->fn_state);
-        }
-        deallocator(v);
-    } else {
-        while(v->next!=handle) {
-            v=v->next;
-            if(v->next==nullptr) {
-                return false;
-            }
-        }
-        void* to_free = v->next;
-        if(to_free==nullptr) {
-            return false;
-        }
-        void* to_free2 = v->next->fn_state;
-        if(v->next->next!=nullptr) {
-            v->next = v->next->next;
-        } else {
+    if(v==nullptr) {
+        return false;
+    }
+    *pv = v->next;
+    player_free_voice(v,deallocator);
+    return true;
+}
+// removes every voice that finished during the last block. they are
+// unlinked first so the callbacks see a consistent voice list
+static void player_remove_finished(voice_handle_t* in_out_first,
+                                void(deallocator)(void*)) {
+    voice_info_t** pv = (voice_info_t**)in_out_first;
+    voice_info_t* finished = nullptr;
+    voice_info_t** pf = &finished;
+    while(*pv!=nullptr) {
+        voice_info_t* v = *pv;
+        if(v->finished) {
+            *pv = v->next;
             v->next = nullptr;
+            *pf = v;
+            pf = &v->next;
+        } else {
+            pv=&v->next;
         }
-        deallocator(to_free);
-        if(to_free2!=nullptr) {
-            deallocator(to_free2);
+    }
+    while(finished!=nullptr) {
+        voice_info_t* v = finished;
+        finished = v->next;
+        if(v->on_finished!=nullptr) {
+            v->on_finished(v,v->on_finished_state);
         }
+        player_free_voice(v,deallocator);
     }
-    return true;
 }
 static bool player_remove_port(voice_handle_t* in_out_first,
                             unsigned short port,
@@ -540,14 +1680,11 @@ static bool player_remove_port(voice_handle_t* in_out_first,
         return false;
     }
     
-    voice_info_t* after = first->next;
+    voice_info_t* after = first;
     while(after!=nullptr && after->port==port) {
-        void* to_free = after;
-        if(after->fn_state!=nullptr) {
-            deallocator(after->fn_state);
-        }
+        voice_info_t* to_free = after;
         after=after->next;
-        deallocator(to_free);
+        player_free_voice(to_free,deallocator);
     }
     if(before!=nullptr) {
         before->next = after;
@@ -557,26 +1694,1090 @@ static bool player_remove_port(voice_handle_t* in_out_first,
 
     return true;
 }
+static const port_info_t* player_find_port(const void* ports, unsigned short port) {
+    const port_info_t* p = (const port_info_t*)ports;
+    while(p!=nullptr && p->port<port) {
+        p=p->next;
+    }
+    if(p!=nullptr && p->port==port) {
+        return p;
+    }
+    return nullptr;
+}
+// finds a port's settings, creating them if necessary
+static port_info_t* player_get_port(void** in_out_ports, 
+                                    unsigned short port, 
+                                    void*(allocator)(size_t)) {
+    port_info_t** pp = (port_info_t**)in_out_ports;
+    while(*pp!=nullptr && (*pp)->port<port) {
+        pp=&(*pp)->next;
+    }
+    if(*pp!=nullptr && (*pp)->port==port) {
+        return *pp;
+    }
+    port_info_t* pnew = (port_info_t*)allocator(sizeof(port_info_t));
+    if(pnew==nullptr) {
+        return nullptr;
+    }
+    pnew->port = port;
+    pnew->gain = 1.0f;
+    pnew->mute = false;
+    pnew->solo = false;
+    pnew->send = 0.0f;
+    pnew->filters = nullptr;
+    pnew->next = *pp;
+    *pp = pnew;
+    return pnew;
+}
+static_assert(PLAYER_BUFFER_ALIGNMENT>0 && PLAYER_BUFFER_ALIGNMENT<=128 && 
+            (PLAYER_BUFFER_ALIGNMENT&(PLAYER_BUFFER_ALIGNMENT-1))==0,
+            "PLAYER_BUFFER_ALIGNMENT must be a power of two no larger than 128");
+// allocates a buffer aligned to, and padded out to a multiple of, 
+// PLAYER_BUFFER_ALIGNMENT. the distance back to the allocated 
+// block is kept in the byte just before the buffer
+static void* player_aligned_alloc(size_t size, void*(allocator)(size_t)) {
+    size = (size+PLAYER_BUFFER_ALIGNMENT-1)&~(size_t)(PLAYER_BUFFER_ALIGNMENT-1);
+    uint8_t* p = (uint8_t*)allocator(size+PLAYER_BUFFER_ALIGNMENT);
+    if(p==nullptr) {
+        return nullptr;
+    }
+    const uint8_t offset = (uint8_t)(PLAYER_BUFFER_ALIGNMENT-((uintptr_t)p&(PLAYER_BUFFER_ALIGNMENT-1)));
+    p+=offset;
+    p[-1]=offset;
+    return p;
+}
+static void player_aligned_free(void* buffer, void(deallocator)(void*)) {
+    if(buffer!=nullptr) {
+        uint8_t* p = (uint8_t*)buffer;
+        deallocator(p-p[-1]);
+    }
+}
+static void player_free_ports(void** in_out_ports, void(deallocator)(void*)) {
+    port_info_t* p = (port_info_t*)*in_out_ports;
+    while(p!=nullptr) {
+        port_info_t* to_free = p;
+        p=p->next;
+        if(to_free->filters!=nullptr) {
+            deallocator(to_free->filters);
+        }
+        deallocator(to_free);
+    }
+    *in_out_ports = nullptr;
+}
+typedef struct sequence_info {
+    unsigned short port;
+    const player_note_t* notes;
+    size_t note_count;
+    // the next note to trigger
+    size_t next_note;
+    unsigned short steps;
+    double step_frames;
+    // the frame on the player's clock the current pass started on
+    unsigned long long origin;
+    bool loop;
+    // the voice pool follows the struct
+    size_t voice_count;
+    voice_info_t** voices;
+    sequence_info* next;
+} sequence_info_t;
+static mix_function_t player_waveform_function(unsigned char waveform) {
+    switch(waveform) {
+        case PLAYER_WAVEFORM_SQR:
+            return sqr_voice;
+        case PLAYER_WAVEFORM_SAW:
+            return saw_voice;
+        case PLAYER_WAVEFORM_TRI:
+            return tri_voice;
+        default:
+            return sin_voice;
+    }
+}
+// a voice pool is a fixed set of waveform voices that stay in the voice
+// list and go idle between notes, so playing notes never allocates
+constexpr static const float player_pool_fade_seconds = .003f;
+static void player_free_pool(voice_info_t** voices, size_t voice_count, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    for(size_t i = 0;i<voice_count;++i) {
+        if(voices[i]!=nullptr) {
+            player_remove_voice(in_out_first,voices[i],deallocator);
+        }
+    }
+}
+// a pool voice is free when it is idle for the whole block, so
+// a voice never holds two notes at once
+static bool player_pool_voice_free(const voice_info_t* v, unsigned long long block_start) {
+    return v->start==player_never || v->stop<=block_start;
+}
+static voice_info_t* player_pool_voice(voice_info_t** voices, size_t voice_count, unsigned long long block_start) {
+    for(size_t i = 0;i<voice_count;++i) {
+        if(player_pool_voice_free(voices[i],block_start)) {
+            return voices[i];
+        }
+    }
+    return nullptr;
+}
+static bool player_pool_busy(voice_info_t*const* voices, size_t voice_count, unsigned long long block_start) {
+    for(size_t i = 0;i<voice_count;++i) {
+        if(!player_pool_voice_free(voices[i],block_start)) {
+            return true;
+        }
+    }
+    return false;
+}
+// gives a pool voice the envelope its notes fade in and out with
+static bool player_pool_envelope(voice_info_t* v, unsigned int sample_rate, void*(allocator)(size_t)) {
+    envelope_info_t* e = (envelope_info_t*)allocator(sizeof(envelope_info_t));
+    if(e==nullptr) {
+        return false;
+    }
+    const size_t frames = (size_t)(player_pool_fade_seconds*sample_rate);
+    e->stage = PLAYER_ENVELOPE_DONE;
+    e->stop = false;
+    e->level = 0.0f;
+    e->decay = 0;
+    e->sustain = 1.0f;
+    e->release = frames!=0?frames:1;
+    v->envelope = e;
+    return true;
+}
+// starts a note on a pool voice. a known stop frame is where the note
+// has finished fading out, so it doesn't hold the voice any longer
+static void player_pool_start(voice_info_t* v, unsigned long long start, unsigned long long stop) {
+    envelope_info_t* e = (envelope_info_t*)v->envelope;
+    e->level = 0.0f;
+    player_envelope_segment(e,PLAYER_ENVELOPE_ATTACK,1.0f,e->release,false);
+    v->start = start;
+    v->stop = stop;
+}
+// lets go of the note on a pool voice at a frame. it fades out after it
+static void player_pool_stop(voice_info_t* v, unsigned long long frame) {
+    const unsigned long long stop = frame+((envelope_info_t*)v->envelope)->release;
+    if(v->start!=player_never && v->stop>stop) {
+        v->stop = stop;
+    }
+}
+// plays a MIDI note number on a pool voice between the start and stop frames
+static void player_pool_play(voice_info_t* v, 
+                            unsigned char note, 
+                            unsigned char waveform, 
+                            float gain, 
+                            unsigned long long start, 
+                            unsigned long long stop, 
+                            unsigned int sample_rate) {
+    waveform_info_t* wi = (waveform_info_t*)v->fn_state;
+    wi->frequency = 440.0f*powf(2.0f,(note-69)/12.0f);
+    wi->phase_delta = player_two_pi*wi->frequency/(float)sample_rate;
+    wi->phase_delta_target = wi->phase_delta;
+    wi->phase = wi->phase_delta*0.5f;
+    v->mix_fn = player_waveform_function(waveform);
+    v->gain = v->gain_target = gain;
+    player_pool_start(v,start,stop);
+}
+// frees a sequence along with its voice pool
+static void player_free_sequence(sequence_info_t* seq, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    player_free_pool(seq->voices,seq->voice_count,in_out_first,deallocator);
+    deallocator(seq);
+}
+// removes the sequence on a port, returning false if there wasn't one
+static bool player_remove_sequence(void** in_out_sequences, unsigned short port, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    sequence_info_t** ps = (sequence_info_t**)in_out_sequences;
+    while(*ps!=nullptr && (*ps)->port!=port) {
+        ps=&(*ps)->next;
+    }
+    sequence_info_t* seq = *ps;
+    if(seq==nullptr) {
+        return false;
+    }
+    *ps = seq->next;
+    player_free_sequence(seq,in_out_first,deallocator);
+    return true;
+}
+static void player_free_sequences(void** in_out_sequences, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    sequence_info_t* seq = (sequence_info_t*)*in_out_sequences;
+    while(seq!=nullptr) {
+        sequence_info_t* to_free = seq;
+        seq=seq->next;
+        player_free_sequence(to_free,in_out_first,deallocator);
+    }
+    *in_out_sequences = nullptr;
+}
+typedef struct {
+    // the offsets of the track's data in the file
+    unsigned long long start;
+    unsigned long long end;
+    // the offset of the next byte to read
+    unsigned long long pos;
+    // the tick of the next event
+    unsigned long tick;
+    // the running status
+    unsigned char status;
+    bool done;
+} midi_track_t;
+typedef struct {
+    unsigned long long frame;
+    unsigned char status;
+    unsigned char data1;
+    unsigned char data2;
+} midi_event_t;
+typedef struct midi_info {
+    unsigned short port;
+    player_on_read_stream_callback on_read_stream;
+    void* on_read_stream_state;
+    player_on_seek_stream_callback on_seek_stream;
+    void* on_seek_stream_state;
+    // the file when it plays from memory
+    const uint8_t* data;
+    size_t size;
+    // the offset the stream is at
+    unsigned long long stream_pos;
+    midi_track_t tracks[PLAYER_MIDI_TRACKS];
+    unsigned short track_count;
+    unsigned short division;
+    // ticks are converted to frames from the last tempo change
+    double tempo_frame;
+    unsigned long tempo_tick;
+    double tick_frames;
+    // the frame the current pass through the file started on
+    double pass_start;
+    bool loop;
+    // set once the file has been parsed to the end
+    bool done;
+    float amplitude;
+    // the parsed events waiting to be played
+    midi_event_t queue[PLAYER_MIDI_QUEUE];
+    size_t queue_head;
+    size_t queue_count;
+    unsigned char waveform[16];
+    // set for channels with a waveform that ignores their program
+    bool waveform_fixed[16];
+    unsigned char volume[16];
+    // the voice pool, and the channel and note each voice plays, follow the struct
+    size_t voice_count;
+    voice_info_t** voices;
+    unsigned short* voice_keys;
+    midi_info* next;
+} midi_info_t;
+// the waveforms for each family of 8 General MIDI programs
+static const unsigned char player_midi_program_waveforms[] = {
+    PLAYER_WAVEFORM_TRI, // piano
+    PLAYER_WAVEFORM_SIN, // chromatic percussion
+    PLAYER_WAVEFORM_SQR, // organ
+    PLAYER_WAVEFORM_SAW, // guitar
+    PLAYER_WAVEFORM_TRI, // bass
+    PLAYER_WAVEFORM_SAW, // strings
+    PLAYER_WAVEFORM_SAW, // ensemble
+    PLAYER_WAVEFORM_SAW, // brass
+    PLAYER_WAVEFORM_SQR, // reed
+    PLAYER_WAVEFORM_SIN, // pipe
+    PLAYER_WAVEFORM_SQR, // synth lead
+    PLAYER_WAVEFORM_TRI, // synth pad
+    PLAYER_WAVEFORM_SAW, // synth effects
+    PLAYER_WAVEFORM_TRI, // ethnic
+    PLAYER_WAVEFORM_SIN, // percussive
+    PLAYER_WAVEFORM_SQR  // sound effects
+};
+// the channel General MIDI uses for drums
+constexpr static const unsigned char player_midi_drum_channel = 9;
+static int player_midi_memory_read(void* state) {
+    midi_info_t* mi = (midi_info_t*)state;
+    if(mi->stream_pos>=mi->size) {
+        return -1;
+    }
+    return mi->data[mi->stream_pos];
+}
+static void player_midi_memory_seek(unsigned long long pos, void* state) {
+    (void)pos;
+    (void)state;
+    // stream_pos is the position
+}
+// reads a byte of the file, tracking where the stream is
+static int player_midi_read_stream(midi_info_t* mi) {
+    const int result = mi->on_read_stream(mi->on_read_stream_state);
+    if(result>=0) {
+        ++mi->stream_pos;
+    }
+    return result;
+}
+static bool player_midi_read_stream_be(midi_info_t* mi, size_t size, uint32_t* out_value) {
+    uint32_t result = 0;
+    while(size--) {
+        const int b = player_midi_read_stream(mi);
+        if(b<0) {
+            return false;
+        }
+        result = (result<<8)|b;
+    }
+    *out_value = result;
+    return true;
+}
+static bool player_midi_seek_stream(midi_info_t* mi, unsigned long long pos) {
+    if(mi->stream_pos==pos) {
+        return true;
+    }
+    if(mi->on_seek_stream==nullptr) {
+        return false;
+    }
+    mi->stream_pos = pos;
+    mi->on_seek_stream(pos,mi->on_seek_stream_state);
+    return true;
+}
+// reads a byte of a track, seeking to it when another track was read last
+static int player_midi_read(midi_info_t* mi, midi_track_t* t) {
+    if(t->pos>=t->end || !player_midi_seek_stream(mi,t->pos)) {
+        return -1;
+    }
+    const int result = player_midi_read_stream(mi);
+    if(result>=0) {
+        ++t->pos;
+    }
+    return result;
+}
+static bool player_midi_read_varlen(midi_info_t* mi, midi_track_t* t, unsigned long* out_value) {
+    unsigned long result = 0;
+    for(int i = 0;i<4;++i) {
+        const int b = player_midi_read(mi,t);
+        if(b<0) {
+            return false;
+        }
+        result = (result<<7)|(b&0x7F);
+        if(!(b&0x80)) {
+            *out_value = result;
+            return true;
+        }
+    }
+    return false;
+}
+// skips data in a track, seeking past it when the stream can seek
+static void player_midi_skip(midi_info_t* mi, midi_track_t* t, unsigned long size) {
+    if(mi->on_seek_stream!=nullptr) {
+        t->pos = t->pos+size<t->end?t->pos+size:t->end;
+        return;
+    }
+    while(size-- && player_midi_read(mi,t)>=0);
+}
+static void player_midi_tempo(midi_info_t* mi, uint32_t microseconds_per_beat, unsigned int sample_rate) {
+    if(mi->division&0x8000) {
+        // SMPTE timing ignores the tempo
+        const int fps = -(int)(signed char)(mi->division>>8);
+        const int ticks_per_frame = mi->division&0xFF;
+        mi->tick_frames = (double)sample_rate/(fps*(ticks_per_frame?ticks_per_frame:1));
+    } else {
+        mi->tick_frames = microseconds_per_beat*1e-6*sample_rate/(mi->division?mi->division:1);
+    }
+}
+// starts the tracks from the top, with the first tick on the specified frame
+static void player_midi_rewind(midi_info_t* mi, double frame, unsigned int sample_rate) {
+    mi->pass_start = frame;
+    mi->tempo_frame = frame;
+    mi->tempo_tick = 0;
+    player_midi_tempo(mi,500000,sample_rate);
+    for(unsigned short i = 0;i<mi->track_count;++i) {
+        midi_track_t* t = &mi->tracks[i];
+        t->pos = t->start;
+        t->status = 0;
+        t->tick = 0;
+        t->done = !player_midi_read_varlen(mi,t,&t->tick);
+    }
+}
+static double player_midi_frame(const midi_info_t* mi, unsigned long tick) {
+    return mi->tempo_frame+(tick-mi->tempo_tick)*mi->tick_frames;
+}
+// parses the next channel event from whichever track has the earliest one.
+// returns false once every track is done
+static bool player_midi_next(midi_info_t* mi, midi_event_t* out_event, unsigned int sample_rate) {
+    while(true) {
+        midi_track_t* t = nullptr;
+        for(unsigned short i = 0;i<mi->track_count;++i) {
+            midi_track_t* c = &mi->tracks[i];
+            if(!c->done && (t==nullptr || c->tick<t->tick)) {
+                t = c;
+            }
+        }
+        if(t==nullptr) {
+            return false;
+        }
+        const double frame = player_midi_frame(mi,t->tick);
+        bool emit = false;
+        int b = player_midi_read(mi,t);
+        if(b<0) {
+            t->done = true;
+            continue;
+        }
+        if(b==0xFF) {
+            const int type = player_midi_read(mi,t);
+            unsigned long size;
+            if(type<0 || type==0x2F || !player_midi_read_varlen(mi,t,&size)) {
+                t->done = true;
+                continue;
+            }
+            if(type==0x51 && size==3) {
+                uint32_t tempo = 0;
+                for(int i = 0;i<3 && b>=0;++i) {
+                    b = player_midi_read(mi,t);
+                    tempo = (tempo<<8)|(b&0xFF);
+                }
+                if(b<0) {
+                    t->done = true;
+                    continue;
+                }
+                mi->tempo_frame = frame;
+                mi->tempo_tick = t->tick;
+                player_midi_tempo(mi,tempo,sample_rate);
+            } else {
+                player_midi_skip(mi,t,size);
+            }
+        } else if(b==0xF0 || b==0xF7) {
+            unsigned long size;
+            if(!player_midi_read_varlen(mi,t,&size)) {
+                t->done = true;
+                continue;
+            }
+            player_midi_skip(mi,t,size);
+        } else {
+            int data1;
+            if(b&0x80) {
+                t->status = (unsigned char)b;
+                data1 = player_midi_read(mi,t);
+            } else {
+                data1 = b;
+            }
+            int data2 = 0;
+            const unsigned char type = t->status&0xF0;
+            if(type!=0xC0 && type!=0xD0) {
+                data2 = player_midi_read(mi,t);
+            }
+            if(t->status<0x80 || data1<0 || data2<0) {
+                t->done = true;
+                continue;
+            }
+            out_event->frame = (unsigned long long)(frame+.5);
+            out_event->status = t->status;
+            out_event->data1 = (unsigned char)data1;
+            out_event->data2 = (unsigned char)data2;
+            emit = true;
+        }
+        unsigned long delta;
+        if(player_midi_read_varlen(mi,t,&delta)) {
+            t->tick+=delta;
+        } else {
+            t->done = true;
+        }
+        if(emit) {
+            return true;
+        }
+    }
+}
+// the frame the last track ended on
+static double player_midi_end(const midi_info_t* mi) {
+    unsigned long tick = mi->tempo_tick;
+    for(unsigned short i = 0;i<mi->track_count;++i) {
+        if(mi->tracks[i].tick>tick) {
+            tick = mi->tracks[i].tick;
+        }
+    }
+    return player_midi_frame(mi,tick);
+}
+// reads the header and finds the tracks. multiple tracks need a seekable stream
+static bool player_midi_open(midi_info_t* mi) {
+    uint32_t id, size, format, track_count, division;
+    if(!player_midi_read_stream_be(mi,4,&id) || id!=0x4D546864 || // MThd
+        !player_midi_read_stream_be(mi,4,&size) || size<6 ||
+        !player_midi_read_stream_be(mi,2,&format) ||
+        !player_midi_read_stream_be(mi,2,&track_count) ||
+        !player_midi_read_stream_be(mi,2,&division) ||
+        track_count==0 || format>1) {
+        return false;
+    }
+    if(track_count>1 && mi->on_seek_stream==nullptr) {
+        return false;
+    }
+    mi->division = (unsigned short)division;
+    unsigned long long pos = mi->stream_pos+(size-6);
+    mi->track_count = 0;
+    while(mi->track_count<track_count && mi->track_count<PLAYER_MIDI_TRACKS) {
+        if(pos!=mi->stream_pos) {
+            if(!player_midi_seek_stream(mi,pos)) {
+                // skip the rest of the header by reading through it
+                while(mi->stream_pos<pos && player_midi_read_stream(mi)>=0);
+                if(mi->stream_pos!=pos) {
+                    break;
+                }
+            }
+        }
+        if(!player_midi_read_stream_be(mi,4,&id) || !player_midi_read_stream_be(mi,4,&size)) {
+            break;
+        }
+        pos = mi->stream_pos+size;
+        if(id!=0x4D54726B) { // MTrk
+            if(mi->on_seek_stream==nullptr) {
+                break;
+            }
+            continue;
+        }
+        midi_track_t* t = &mi->tracks[mi->track_count++];
+        t->start = mi->stream_pos;
+        t->end = pos;
+        if(mi->on_seek_stream==nullptr) {
+            break;
+        }
+    }
+    return mi->track_count!=0;
+}
+static midi_info_t* player_midi_alloc(size_t voices, void*(allocator)(size_t)) {
+    return (midi_info_t*)allocator(sizeof(midi_info_t)+voices*(sizeof(voice_info_t*)+sizeof(unsigned short)));
+}
+static void player_free_midi(midi_info_t* mi, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    player_free_pool(mi->voices,mi->voice_count,in_out_first,deallocator);
+    deallocator(mi);
+}
+// removes the MIDI file on a port, returning false if there wasn't one
+static bool player_remove_midi(void** in_out_midi, unsigned short port, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    midi_info_t** pm = (midi_info_t**)in_out_midi;
+    while(*pm!=nullptr && (*pm)->port!=port) {
+        pm=&(*pm)->next;
+    }
+    midi_info_t* mi = *pm;
+    if(mi==nullptr) {
+        return false;
+    }
+    *pm = mi->next;
+    player_free_midi(mi,in_out_first,deallocator);
+    return true;
+}
+static void player_free_midis(void** in_out_midi, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    midi_info_t* mi = (midi_info_t*)*in_out_midi;
+    while(mi!=nullptr) {
+        midi_info_t* to_free = mi;
+        mi=mi->next;
+        player_free_midi(to_free,in_out_first,deallocator);
+    }
+    *in_out_midi = nullptr;
+}
+// plays a parsed event. events that are late start at the top of the block.
+// returns false if a note has to wait for a voice to free up
+static bool player_midi_play(midi_info_t* mi, const midi_event_t& ev, unsigned long long block_start, unsigned int sample_rate) {
+    const unsigned char channel = ev.status&0x0F;
+    const unsigned long long frame = ev.frame>block_start?ev.frame:block_start;
+    const unsigned short key = (channel<<8)|ev.data1;
+    unsigned char type = ev.status&0xF0;
+    if(type==0x90 && ev.data2==0) {
+        // a note on with no velocity is a note off
+        type = 0x80;
+    }
+    switch(type) {
+        case 0x90: {
+                if(channel==player_midi_drum_channel) {
+                    break;
+                }
+                voice_info_t* v = player_pool_voice(mi->voices,mi->voice_count,block_start);
+                size_t index = 0;
+                if(v==nullptr) {
+                    // cut the oldest note here, and start this one on the
+                    // next block once its voice is free
+                    for(size_t i = 1;i<mi->voice_count;++i) {
+                        if(mi->voices[i]->start<mi->voices[index]->start) {
+                            index = i;
+                        }
+                    }
+                    player_pool_stop(mi->voices[index],frame);
+                    return false;
+                }
+                while(mi->voices[index]!=v) {
+                    ++index;
+                }
+                const float gain = mi->amplitude*(ev.data2/127.0f)*(mi->volume[channel]/127.0f);
+                player_pool_play(v,ev.data1,mi->waveform[channel],gain,frame,player_never,sample_rate);
+                mi->voice_keys[index] = key;
+            }
+            break;
+        case 0x80:
+            for(size_t i = 0;i<mi->voice_count;++i) {
+                voice_info_t* v = mi->voices[i];
+                if(mi->voice_keys[i]==key && v->start!=player_never && v->stop==player_never) {
+                    player_pool_stop(v,frame);
+                    break;
+                }
+            }
+            break;
+        case 0xB0:
+            if(ev.data1==7) {
+                mi->volume[channel] = ev.data2;
+            } else if(ev.data1==120 || ev.data1==123) {
+                // all sound or all notes off
+                for(size_t i = 0;i<mi->voice_count;++i) {
+                    if((mi->voice_keys[i]>>8)==channel) {
+                        player_pool_stop(mi->voices[i],frame);
+                    }
+                }
+            }
+            break;
+        case 0xC0:
+            if(!mi->waveform_fixed[channel]) {
+                mi->waveform[channel] = player_midi_program_waveforms[(ev.data1&0x7F)>>3];
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+// the number of samples in a MOD
+constexpr static const size_t player_mod_samples = 31;
+constexpr static const size_t player_mod_rows = 64;
+// the offset of the first pattern in the file
+constexpr static const size_t player_mod_header_size = 1084;
+// the Amiga clock that MOD periods divide, for PAL machines
+constexpr static const double player_mod_clock = 3546894.6;
+typedef struct {
+    const int8_t* data;
+    unsigned long length;
+    unsigned long loop_start;
+    unsigned long loop_length;
+    // the pitch multiplier for the finetune
+    float finetune;
+    unsigned char volume;
+} mod_sample_t;
+typedef struct {
+    // the current sample, starting at 1
+    unsigned char sample;
+    int period;
+    // where tone portamento is headed
+    int target_period;
+    unsigned char porta_speed;
+    int volume;
+    unsigned char effect;
+    unsigned char param;
+    // the last sample offset, in pages of 256 bytes, which effect 9
+    // reuses when its parameter is 0
+    unsigned char offset;
+    // which of the channel's two voices has the current note. a new note
+    // starts on the other one so the old note plays right up to it
+    unsigned char active;
+} mod_channel_t;
+typedef struct mod_info {
+    unsigned short port;
+    const uint8_t* data;
+    unsigned short channel_count;
+    mod_sample_t samples[player_mod_samples];
+    const uint8_t* orders;
+    unsigned char song_length;
+    unsigned char restart;
+    const uint8_t* patterns;
+    unsigned char order;
+    unsigned char row;
+    unsigned char tick;
+    unsigned char speed;
+    unsigned char tempo;
+    // the frame on the player's clock the next tick starts on
+    double next_tick;
+    // set by pattern jumps and breaks for the end of the row
+    int jump_order;
+    int break_row;
+    bool loop;
+    bool done;
+    float amplitude;
+    mod_channel_t channels[PLAYER_MOD_CHANNELS];
+    voice_info_t* voices[PLAYER_MOD_CHANNELS*2];
+    mod_info* next;
+} mod_info_t;
+static unsigned long player_mod_word(const uint8_t* p) {
+    return ((unsigned long)p[0]<<8)|p[1];
+}
+// reads the sample table and finds the patterns and sample data
+static bool player_mod_open(mod_info_t* mi, const uint8_t* data, size_t size) {
+    if(size<player_mod_header_size) {
+        return false;
+    }
+    const uint8_t* sig = data+1080;
+    unsigned short channel_count = 0;
+    if(0==memcmp(sig,"M.K.",4) || 0==memcmp(sig,"M!K!",4) || 0==memcmp(sig,"FLT4",4) || 0==memcmp(sig,"4CHN",4)) {
+        channel_count = 4;
+    } else if(0==memcmp(sig,"6CHN",4)) {
+        channel_count = 6;
+    } else if(0==memcmp(sig,"8CHN",4) || 0==memcmp(sig,"FLT8",4)) {
+        channel_count = 8;
+    }
+    if(channel_count==0 || channel_count>PLAYER_MOD_CHANNELS) {
+        return false;
+    }
+    mi->data = data;
+    mi->channel_count = channel_count;
+    mi->song_length = data[950];
+    mi->restart = data[951];
+    mi->orders = data+952;
+    if(mi->song_length==0 || mi->song_length>128) {
+        return false;
+    }
+    if(mi->restart>=mi->song_length) {
+        mi->restart = 0;
+    }
+    unsigned char pattern_count = 0;
+    for(size_t i = 0;i<128;++i) {
+        if(mi->orders[i]>=pattern_count) {
+            pattern_count = mi->orders[i]+1;
+        }
+    }
+    const size_t pattern_size = player_mod_rows*channel_count*4;
+    mi->patterns = data+player_mod_header_size;
+    size_t offset = player_mod_header_size+pattern_count*pattern_size;
+    if(offset>size) {
+        return false;
+    }
+    for(size_t i = 0;i<player_mod_samples;++i) {
+        const uint8_t* h = data+20+i*30;
+        mod_sample_t& smp = mi->samples[i];
+        unsigned long length = player_mod_word(h+22)*2;
+        // samples cut short by the end of the file are truncated
+        if(offset+length>size) {
+            length = size-offset;
+        }
+        smp.data = (const int8_t*)(data+offset);
+        smp.length = length;
+        smp.loop_start = player_mod_word(h+26)*2;
+        smp.loop_length = player_mod_word(h+28)*2;
+        if(smp.loop_length<=2 || smp.loop_start>=length) {
+            smp.loop_start = 0;
+            smp.loop_length = 0;
+        } else if(smp.loop_start+smp.loop_length>length) {
+            smp.loop_length = length-smp.loop_start;
+        }
+        // finetune is in eighths of a semitone, from -8 to 7
+        const int finetune = (int)(h[24]&0x0F)-((h[24]&0x08)?16:0);
+        smp.finetune = powf(2.0f,finetune/96.0f);
+        smp.volume = h[25]>64?64:h[25];
+        offset+=length;
+    }
+    return true;
+}
+static void player_free_mod(mod_info_t* mi, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    player_free_pool(mi->voices,mi->channel_count*2,in_out_first,deallocator);
+    deallocator(mi);
+}
+// removes the module on a port, returning false if there wasn't one
+static bool player_remove_mod(void** in_out_mods, unsigned short port, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    mod_info_t** pm = (mod_info_t**)in_out_mods;
+    while(*pm!=nullptr && (*pm)->port!=port) {
+        pm=&(*pm)->next;
+    }
+    mod_info_t* mi = *pm;
+    if(mi==nullptr) {
+        return false;
+    }
+    *pm = mi->next;
+    player_free_mod(mi,in_out_first,deallocator);
+    return true;
+}
+static void player_free_mods(void** in_out_mods, voice_handle_t* in_out_first, void(deallocator)(void*)) {
+    mod_info_t* mi = (mod_info_t*)*in_out_mods;
+    while(mi!=nullptr) {
+        mod_info_t* to_free = mi;
+        mi=mi->next;
+        player_free_mod(to_free,in_out_first,deallocator);
+    }
+    *in_out_mods = nullptr;
+}
+// the frames per tick at a tempo in beats per minute
+static double player_mod_tick_frames(unsigned char tempo, unsigned int sample_rate) {
+    return sample_rate*2.5/tempo;
+}
+// points the channel's current voice at its pitch and volume. arpeggio
+// raises the pitch by a number of semitones without changing the period
+static void player_mod_apply(mod_info_t* mi, size_t channel, int semitones, unsigned int sample_rate) {
+    const mod_channel_t& ch = mi->channels[channel];
+    voice_info_t* v = mi->voices[channel*2+ch.active];
+    if(ch.sample==0 || ch.period==0) {
+        return;
+    }
+    const mod_sample_t& smp = mi->samples[ch.sample-1];
+    double frequency = player_mod_clock/ch.period*smp.finetune;
+    if(semitones!=0) {
+        frequency*=pow(2.0,semitones/12.0);
+    }
+    sample_info_t* si = (sample_info_t*)v->fn_state;
+    si->step = (unsigned long long)(frequency/sample_rate*4294967296.0);
+    v->gain_target = mi->amplitude*ch.volume/64.0f;
+}
+// starts the channel's sample on its other voice, on the specified frame
+static void player_mod_trigger(mod_info_t* mi, size_t channel, unsigned long offset, unsigned long long frame) {
+    mod_channel_t& ch = mi->channels[channel];
+    const mod_sample_t& smp = mi->samples[ch.sample-1];
+    player_pool_stop(mi->voices[channel*2+ch.active],frame);
+    if(smp.length<2 || offset>=smp.length) {
+        return;
+    }
+    ch.active^=1;
+    voice_info_t* v = mi->voices[channel*2+ch.active];
+    sample_info_t* si = (sample_info_t*)v->fn_state;
+    si->data = smp.data;
+    si->loop_start = smp.loop_start;
+    si->loop_length = smp.loop_length;
+    si->length = smp.loop_length!=0?smp.loop_start+smp.loop_length:smp.length;
+    si->pos = (unsigned long long)offset<<32;
+    v->gain = v->gain_target = mi->amplitude*ch.volume/64.0f;
+    player_pool_start(v,frame,player_never);
+}
+static void player_mod_clamp_period(mod_channel_t& ch) {
+    if(ch.period<28) {
+        ch.period = 28;
+    } else if(ch.period>3424) {
+        ch.period = 3424;
+    }
+}
+// reads a row of the pattern and starts its notes and effects
+static void player_mod_row(mod_info_t* mi, unsigned long long frame, unsigned int sample_rate) {
+    const uint8_t* cell = mi->patterns+((size_t)mi->orders[mi->order]*player_mod_rows+mi->row)*mi->channel_count*4;
+    mi->jump_order = -1;
+    mi->break_row = -1;
+    for(size_t i = 0;i<mi->channel_count;++i,cell+=4) {
+        mod_channel_t& ch = mi->channels[i];
+        const unsigned char sample = (cell[0]&0xF0)|(cell[2]>>4);
+        const int period = ((cell[0]&0x0F)<<8)|cell[1];
+        ch.effect = cell[2]&0x0F;
+        ch.param = cell[3];
+        if(sample!=0 && sample<=player_mod_samples) {
+            ch.sample = sample;
+            ch.volume = mi->samples[sample-1].volume;
+        }
+        bool trigger = false;
+        if(period!=0) {
+            if(ch.effect==0x3) {
+                ch.target_period = period;
+            } else {
+                ch.period = period;
+                trigger = ch.sample!=0;
+            }
+        }
+        switch(ch.effect) {
+            case 0x3:
+                if(ch.param!=0) {
+                    ch.porta_speed = ch.param;
+                }
+                break;
+            case 0xB:
+                mi->jump_order = ch.param;
+                break;
+            case 0xC:
+                ch.volume = ch.param>64?64:ch.param;
+                break;
+            case 0xD:
+                mi->break_row = (ch.param>>4)*10+(ch.param&0x0F);
+                break;
+            case 0xE:
+                switch(ch.param>>4) {
+                    case 0x1:
+                        ch.period-=ch.param&0x0F;
+                        player_mod_clamp_period(ch);
+                        break;
+                    case 0x2:
+                        ch.period+=ch.param&0x0F;
+                        player_mod_clamp_period(ch);
+                        break;
+                    case 0xA:
+                        ch.volume+=ch.param&0x0F;
+                        break;
+                    case 0xB:
+                        ch.volume-=ch.param&0x0F;
+                        break;
+                    case 0xC:
+                        if((ch.param&0x0F)==0) {
+                            ch.volume = 0;
+                        }
+                        break;
+                }
+                break;
+            case 0xF:
+                if(ch.param>=32) {
+                    mi->tempo = ch.param;
+                } else if(ch.param!=0) {
+                    mi->speed = ch.param;
+                }
+                break;
+        }
+        if(ch.volume<0) {
+            ch.volume = 0;
+        } else if(ch.volume>64) {
+            ch.volume = 64;
+        }
+        if(trigger) {
+            unsigned long offset = 0;
+            if(ch.effect==0x9) {
+                if(ch.param!=0) {
+                    ch.offset = ch.param;
+                }
+                offset = ch.offset*256UL;
+            }
+            player_mod_trigger(mi,i,offset,frame);
+        }
+        player_mod_apply(mi,i,0,sample_rate);
+    }
+}
+// runs the effects that continue on the ticks after the first of a row
+static void player_mod_effects(mod_info_t* mi, unsigned int sample_rate) {
+    for(size_t i = 0;i<mi->channel_count;++i) {
+        mod_channel_t& ch = mi->channels[i];
+        int semitones = 0;
+        switch(ch.effect) {
+            case 0x0:
+                if(ch.param!=0) {
+                    const unsigned char step = mi->tick%3;
+                    semitones = step==1?ch.param>>4:step==2?ch.param&0x0F:0;
+                }
+                break;
+            case 0x1:
+                ch.period-=ch.param;
+                player_mod_clamp_period(ch);
+                break;
+            case 0x2:
+                ch.period+=ch.param;
+                player_mod_clamp_period(ch);
+                break;
+            case 0x3:
+                if(ch.target_period!=0) {
+                    if(ch.period<ch.target_period) {
+                        ch.period+=ch.porta_speed;
+                        if(ch.period>ch.target_period) {
+                            ch.period = ch.target_period;
+                        }
+                    } else if(ch.period>ch.target_period) {
+                        ch.period-=ch.porta_speed;
+                        if(ch.period<ch.target_period) {
+                            ch.period = ch.target_period;
+                        }
+                    }
+                }
+                break;
+            case 0xA:
+                // up by x when it's set, otherwise down by y
+                ch.volume+=(ch.param>>4)?(ch.param>>4):-(ch.param&0x0F);
+                if(ch.volume<0) {
+                    ch.volume = 0;
+                } else if(ch.volume>64) {
+                    ch.volume = 64;
+                }
+                break;
+            case 0xE:
+                if((ch.param>>4)==0xC && mi->tick==(ch.param&0x0F)) {
+                    ch.volume = 0;
+                }
+                break;
+        }
+        player_mod_apply(mi,i,semitones,sample_rate);
+    }
+}
+// moves to the next row once the row's ticks are done, following jumps
+// and breaks. returns false when a module that doesn't loop has ended
+static bool player_mod_advance(mod_info_t* mi) {
+    if(++mi->tick<mi->speed) {
+        return true;
+    }
+    mi->tick = 0;
+    int order = mi->order;
+    int row = mi->row+1;
+    if(mi->jump_order>=0) {
+        // jumping back is how a module loops itself
+        if(!mi->loop && mi->jump_order<=mi->order) {
+            return false;
+        }
+        order = mi->jump_order;
+        row = 0;
+    }
+    if(mi->break_row>=0) {
+        if(mi->jump_order<0) {
+            ++order;
+        }
+        row = mi->break_row<(int)player_mod_rows?mi->break_row:0;
+    }
+    if(row>=(int)player_mod_rows) {
+        row = 0;
+        ++order;
+    }
+    if(order>=mi->song_length) {
+        if(!mi->loop) {
+            return false;
+        }
+        order = mi->restart;
+    }
+    mi->order = (unsigned char)order;
+    mi->row = (unsigned char)row;
+    return true;
+}
 
 void player::do_move(player& rhs) {
     m_first = rhs.m_first ;
     rhs.m_first = nullptr;
+    m_ports = rhs.m_ports;
+    rhs.m_ports = nullptr;
+    m_sequences = rhs.m_sequences;
+    rhs.m_sequences = nullptr;
+    m_midi = rhs.m_midi;
+    rhs.m_midi = nullptr;
+    m_mods = rhs.m_mods;
+    rhs.m_mods = nullptr;
     m_buffer = rhs.m_buffer;
     rhs.m_buffer = nullptr;
+    m_buffer_external = rhs.m_buffer_external;
+    rhs.m_buffer_external = nullptr;
+    m_buffer_external_size = rhs.m_buffer_external_size;
+    m_mix = rhs.m_mix;
+    rhs.m_mix = nullptr;
+    m_bus = rhs.m_bus;
+    rhs.m_bus = nullptr;
+    m_voice_mix = rhs.m_voice_mix;
+    rhs.m_voice_mix = nullptr;
+    m_filters = rhs.m_filters;
+    rhs.m_filters = nullptr;
+    m_send = rhs.m_send;
+    rhs.m_send = nullptr;
+    m_effects = rhs.m_effects;
+    rhs.m_effects = nullptr;
+    m_limiter_delay = rhs.m_limiter_delay;
+    rhs.m_limiter_delay = nullptr;
+    m_limiter = rhs.m_limiter;
+    m_limiter_threshold = rhs.m_limiter_threshold;
+    m_limiter_release = rhs.m_limiter_release;
+    m_limiter_gain = rhs.m_limiter_gain;
+    m_limiter_peak = rhs.m_limiter_peak;
+    m_scratch = rhs.m_scratch;
+    rhs.m_scratch = nullptr;
     m_frame_count = rhs.m_frame_count;
     rhs.m_frame_count = 0;
+    m_clock = rhs.m_clock;
+    m_sink_latency = rhs.m_sink_latency;
+    m_noise_seed = rhs.m_noise_seed;
     m_sample_rate = rhs.m_sample_rate;
+    m_channel_count = rhs.m_channel_count;
+    m_bit_depth = rhs.m_bit_depth;
+    m_format = rhs.m_format;
     m_sample_max = rhs.m_sample_max;
     m_auto_disable = rhs.m_auto_disable;
     m_sound_enabled = rhs.m_sound_enabled;
+    m_buffer_silent = rhs.m_buffer_silent;
     m_on_sound_disable_cb=rhs.m_on_sound_disable_cb;
-    rhs.m_on_sound_enable_cb = nullptr;
+    rhs.m_on_sound_disable_cb = nullptr;
     m_on_sound_disable_state = rhs.m_on_sound_disable_state;
     m_on_sound_enable_cb = rhs.m_on_sound_enable_cb;
     rhs.m_on_sound_enable_cb = nullptr;
     m_on_flush_cb = rhs.m_on_flush_cb;
     rhs.m_on_flush_cb = nullptr;
     m_on_flush_state = rhs.m_on_flush_state;
+    m_on_acquire_buffer_cb = rhs.m_on_acquire_buffer_cb;
+    rhs.m_on_acquire_buffer_cb = nullptr;
+    m_on_acquire_buffer_state = rhs.m_on_acquire_buffer_state;
+    m_on_commit_buffer_cb = rhs.m_on_commit_buffer_cb;
+    rhs.m_on_commit_buffer_cb = nullptr;
+    m_on_commit_buffer_state = rhs.m_on_commit_buffer_state;
+    m_on_deadline_miss_cb = rhs.m_on_deadline_miss_cb;
+    rhs.m_on_deadline_miss_cb = nullptr;
+    m_on_deadline_miss_state = rhs.m_on_deadline_miss_state;
+    m_last_update = rhs.m_last_update;
+    m_last_update_valid = rhs.m_last_update_valid;
+    m_deadline_tolerance = rhs.m_deadline_tolerance;
+    m_late_blocks = rhs.m_late_blocks;
+    m_max_lateness = rhs.m_max_lateness;
+    m_total_lateness = rhs.m_total_lateness;
+#ifdef PLAYER_INSTRUMENTATION
+    m_render_timing = rhs.m_render_timing;
+    m_flush_timing = rhs.m_flush_timing;
+#endif
     m_allocator = rhs.m_allocator;
     m_reallocator = rhs.m_reallocator;
     m_deallocator = rhs.m_deallocator;
@@ -589,26 +2790,109 @@ player::player(unsigned int sample_rate,
             void*(reallocator)(void*,size_t), 
             void(deallocator)(void*)) :
                 m_first(nullptr),
+                m_ports(nullptr),
+                m_sequences(nullptr),
+                m_midi(nullptr),
+                m_mods(nullptr),
                 m_buffer(nullptr),
+                m_buffer_external(nullptr),
+                m_buffer_external_size(0),
+                m_mix(nullptr),
+                m_bus(nullptr),
+                m_voice_mix(nullptr),
+                m_filters(nullptr),
+                m_send(nullptr),
+                m_effects(nullptr),
+                m_limiter_delay(nullptr),
+                m_limiter(false),
+                m_limiter_threshold(1.0f),
+                m_limiter_release(.1f),
+                m_limiter_gain(1.0f),
+                m_limiter_peak(0.0f),
+                m_scratch(nullptr),
                 m_frame_count(frame_count),
+                m_clock(0),
+                m_sink_latency(0),
+                m_noise_seed(0x9E3779B9),
                 m_sample_rate(sample_rate),
                 m_channel_count(channel_count),
                 m_bit_depth(bit_depth),
+                m_format(bit_depth==8?PLAYER_FORMAT_U8:PLAYER_FORMAT_U16),
                 m_auto_disable(true),
                 m_sound_enabled(false),
+                m_buffer_silent(false),
                 m_on_sound_disable_cb(nullptr),
                 m_on_sound_disable_state(nullptr),
                 m_on_sound_enable_cb(nullptr),
                 m_on_sound_enable_state(nullptr),
                 m_on_flush_cb(nullptr),
                 m_on_flush_state(nullptr),
+                m_on_acquire_buffer_cb(nullptr),
+                m_on_acquire_buffer_state(nullptr),
+                m_on_commit_buffer_cb(nullptr),
+                m_on_commit_buffer_state(nullptr),
+                m_on_deadline_miss_cb(nullptr),
+                m_on_deadline_miss_state(nullptr),
+                m_last_update(0),
+                m_last_update_valid(false),
+                m_deadline_tolerance(.25f),
+                m_late_blocks(0),
+                m_max_lateness(0),
+                m_total_lateness(0),
                 m_allocator(allocator),
                 m_reallocator(reallocator),
                 m_deallocator(deallocator)
                 {
+#ifdef PLAYER_INSTRUMENTATION
+    reset_timing();
+#endif
+}
+player::player(unsigned int sample_rate, 
+            unsigned short channel_count, 
+            player_format_t format, 
+            size_t frame_count, 
+            void*(allocator)(size_t), 
+            void*(reallocator)(void*,size_t), 
+            void(deallocator)(void*)) :
+                player(sample_rate,
+                    channel_count,
+                    player_format_bit_depth(format),
+                    frame_count,
+                    allocator,
+                    reallocator,
+                    deallocator) {
+    m_format = format;
+}
+void player::free_buffers() {
+    if(m_buffer!=m_buffer_external) {
+        player_aligned_free(m_buffer,m_deallocator);
+    }
+    m_buffer = nullptr;
+    player_aligned_free(m_scratch,m_deallocator);
+    m_scratch = nullptr;
+    player_aligned_free(m_mix,m_deallocator);
+    m_mix = nullptr;
+    player_aligned_free(m_bus,m_deallocator);
+    m_bus = nullptr;
+    player_aligned_free(m_voice_mix,m_deallocator);
+    m_voice_mix = nullptr;
+    player_aligned_free(m_send,m_deallocator);
+    m_send = nullptr;
+    player_aligned_free(m_limiter_delay,m_deallocator);
+    m_limiter_delay = nullptr;
 }
 player::~player() {
     deinitialize();
+    player_free_sequences(&m_sequences,&m_first,m_deallocator);
+    player_free_midis(&m_midi,&m_first,m_deallocator);
+    player_free_mods(&m_mods,&m_first,m_deallocator);
+    player_free_ports(&m_ports,m_deallocator);
+    if(m_filters!=nullptr) {
+        m_deallocator(m_filters);
+        m_filters = nullptr;
+    }
+    send_delay(0.0f);
+    send_reverb(0.0f,0.0f,0.0f);
 }
 player::player(player&& rhs) {
     do_move(rhs);    
@@ -622,11 +2906,33 @@ bool player::initialize() {
     if(m_buffer!=nullptr) {
         return true;
     }
-    m_buffer=m_allocator(m_frame_count*m_channel_count*(m_bit_depth/8));
-    if(m_buffer==nullptr) {
+    const size_t sample_count = m_frame_count*m_channel_count;
+    if(m_buffer_external!=nullptr) {
+        if(m_buffer_external_size<buffer_size()) {
+            return false;
+        }
+        m_buffer = m_buffer_external;
+    } else {
+        m_buffer=player_aligned_alloc(sample_count*(m_bit_depth/8),m_allocator);
+        if(m_buffer==nullptr) {
+            return false;
+        }
+    }
+    m_buffer_silent = false;
+    m_scratch=player_aligned_alloc(sample_count*(player_voice_bit_depth(m_format)/8),m_allocator);
+    m_mix=(float*)player_aligned_alloc(sample_count*sizeof(float),m_allocator);
+    m_bus=(float*)player_aligned_alloc(sample_count*sizeof(float),m_allocator);
+    m_voice_mix=(float*)player_aligned_alloc(sample_count*sizeof(float),m_allocator);
+    m_send=(float*)player_aligned_alloc(m_frame_count*sizeof(float),m_allocator);
+    if(m_limiter) {
+        m_limiter_delay=(float*)player_aligned_alloc(sample_count*sizeof(float),m_allocator);
+    }
+    if(m_scratch==nullptr||m_mix==nullptr||m_bus==nullptr||m_voice_mix==nullptr||m_send==nullptr||(m_limiter && m_limiter_delay==nullptr)) {
+        free_buffers();
         return false;
     }
-    m_sample_max = powf(2,m_bit_depth)-1;
+    limiter_reset();
+    m_sample_max = (1U<<player_voice_bit_depth(m_format))-1;
     if(m_auto_disable==false) {
         m_sound_enabled = true;
         if(m_on_sound_enable_cb!=nullptr) {
@@ -644,28 +2950,31 @@ void player::deinitialize() {
         m_on_sound_disable_cb(m_on_sound_disable_state);
         m_sound_enabled=false;
     }
-    m_deallocator(m_buffer);
-    m_buffer = nullptr;
-    
+    free_buffers();
 
 }
 static voice_handle_t player_waveform(unsigned short port, 
                                     unsigned int sample_rate,
                                     voice_handle_t* in_out_first, 
-                                    voice_function_t fn, 
+                                    mix_function_t fn, 
                                     float frequency, 
                                     float amplitude, 
-                                    void*(allocator)(size_t)) {
+                                    void*(allocator)(size_t),
+                                    void(deallocator)(void*)) {
     waveform_info_t* wi = (waveform_info_t*)allocator(sizeof(waveform_info_t));
     if(wi==nullptr) {
         return nullptr;
     }
     wi->frequency = frequency;
-    wi->amplitude = amplitude;
     wi->phase_delta = player_two_pi*wi->frequency/(float)sample_rate;
+    wi->phase_delta_target = wi->phase_delta;
     wi->phase = wi->phase_delta*0.5f;
     
-    return player_add_voice(port, in_out_first,fn,wi,allocator);
+    voice_handle_t res = player_add_voice(port, in_out_first,nullptr,fn,wi,amplitude,allocator);
+    if(res==nullptr) {
+        deallocator(wi);
+    }
+    return res;
 }
 voice_handle_t player::sin(unsigned short port, float frequency, float amplitude) {
     voice_handle_t result = player_waveform(port,
@@ -674,7 +2983,8 @@ voice_handle_t player::sin(unsigned short port, float frequency, float amplitude
                                             sin_voice,
                                             frequency,
                                             amplitude,
-                                            m_allocator);
+                                            m_allocator,
+                                            m_deallocator);
     return result;
 }
 voice_handle_t player::sqr(unsigned short port, float frequency, float amplitude) {
@@ -684,7 +2994,8 @@ voice_handle_t player::sqr(unsigned short port, float frequency, float amplitude
                                             sqr_voice,
                                             frequency,
                                             amplitude,
-                                            m_allocator);
+                                            m_allocator,
+                                            m_deallocator);
     return result;
 }
 voice_handle_t player::saw(unsigned short port, float frequency, float amplitude) {
@@ -694,7 +3005,8 @@ voice_handle_t player::saw(unsigned short port, float frequency, float amplitude
                                             saw_voice,
                                             frequency,
                                             amplitude,
-                                            m_allocator);
+                                            m_allocator,
+                                            m_deallocator);
     return result;
 }
 voice_handle_t player::tri(unsigned short port, float frequency, float amplitude) {
@@ -704,9 +3016,66 @@ voice_handle_t player::tri(unsigned short port, float frequency, float amplitude
                                             tri_voice,
                                             frequency,
                                             amplitude,
-                                            m_allocator);
+                                            m_allocator,
+                                            m_deallocator);
     return result;
 }
+voice_handle_t player::fm(unsigned short port, 
+                        float frequency, 
+                        const player_fm_operator_t* operators, 
+                        size_t operator_count, 
+                        float amplitude) {
+    if(operators==nullptr || operator_count==0 || operator_count>PLAYER_FM_OPERATORS || frequency<0.0f) {
+        return nullptr;
+    }
+    fm_info_t* fi = (fm_info_t*)m_allocator(sizeof(fm_info_t));
+    if(fi==nullptr) {
+        return nullptr;
+    }
+    fi->operator_count = operator_count;
+    for(size_t i = 0;i<operator_count;++i) {
+        const player_fm_operator_t& op = operators[i];
+        fi->ratio[i] = op.ratio;
+        fi->index[i] = op.index;
+        fi->phase[i] = 0;
+        envelope_info_t* e = &fi->envelopes[i];
+        e->level = 0.0f;
+        e->stop = false;
+        e->decay = (size_t)(op.decay*m_sample_rate);
+        e->sustain = op.sustain;
+        e->release = (size_t)(op.release*m_sample_rate);
+        player_envelope_segment(e,PLAYER_ENVELOPE_ATTACK,1.0f,(size_t)(op.attack*m_sample_rate),false);
+    }
+    player_fm_frequency(fi,frequency,m_sample_rate);
+    voice_handle_t res = player_add_voice(port,&m_first,nullptr,fm_voice,fi,amplitude,m_allocator);
+    if(res==nullptr) {
+        m_deallocator(fi);
+    }
+    return res;
+}
+voice_handle_t player::noise(unsigned short port, player_noise_t type, float amplitude) {
+    if(type>PLAYER_NOISE_BROWN) {
+        return nullptr;
+    }
+    noise_info_t* ni = (noise_info_t*)m_allocator(sizeof(noise_info_t));
+    if(ni==nullptr) {
+        return nullptr;
+    }
+    // each voice gets its own seeds from the player so they aren't
+    // correlated, and players don't share any state
+    ni->type = type;
+    for(size_t i = 0;i<player_noise_lanes;++i) {
+        m_noise_seed = m_noise_seed*1664525+1013904223;
+        ni->state[i] = m_noise_seed|1;
+    }
+    ni->b0 = ni->b1 = ni->b2 = 0.0f;
+    ni->brown = 0.0f;
+    voice_handle_t res = player_add_voice(port,&m_first,nullptr,noise_voice,ni,amplitude,m_allocator);
+    if(res==nullptr) {
+        m_deallocator(ni);
+    }
+    return res;
+}
 voice_handle_t player::wav(unsigned short port, 
                         player_on_read_stream_callback on_read_stream, 
                         void* on_read_stream_state, float amplitude, 
@@ -851,7 +3220,6 @@ voice_handle_t player::wav(unsigned short port,
     wi->on_read_stream_state = on_read_stream_state;
     wi->on_seek_stream = on_seek_stream;
     wi->on_seek_stream_state = on_seek_stream_state;
-    wi->amplitude = amplitude;
     wi->bit_depth = bit_depth;
     wi->channel_count = channel_count;
     wi->loop = loop;
@@ -861,71 +3229,844 @@ voice_handle_t player::wav(unsigned short port,
     wi->length = length;
     wi->pos = 0;
 
-    if(wi->channel_count==2 && wi->bit_depth==16 && m_channel_count==2 && m_bit_depth==16) {
-        voice_handle_t res = player_add_voice(port, &m_first,wav_voice_16_2_to_16_2,wi,m_allocator);
-        if(res==nullptr) {
-            m_deallocator(wi);
+    mix_function_t fn = nullptr;
+    if(wi->bit_depth==16) {
+        if(wi->channel_count==2) {
+            if(m_channel_count==2) {
+                fn = wav_voice_16_2_to_2;
+            } else if(m_channel_count==1) {
+                fn = wav_voice_16_2_to_1;
+            }
+        } else if(wi->channel_count==1) {
+            if(m_channel_count==2) {
+                fn = wav_voice_16_1_to_2;
+            } else if(m_channel_count==1) {
+                fn = wav_voice_16_1_to_1;
+            }
         }
-        return res;
-    } else if(wi->channel_count==1 && wi->bit_depth==16 && m_channel_count==2 && m_bit_depth==16) {
-        voice_handle_t res = player_add_voice(port, &m_first,wav_voice_16_1_to_16_2,wi,m_allocator);
+    }
+    if(fn!=nullptr) {
+        voice_handle_t res = player_add_voice(port, &m_first,nullptr,fn,wi,amplitude,m_allocator);
         if(res==nullptr) {
             m_deallocator(wi);
         }
         return res;
-    } else if(wi->channel_count==2 && wi->bit_depth==16 && m_channel_count==1 && m_bit_depth==16) {
-        voice_handle_t res = player_add_voice(port, &m_first,wav_voice_16_2_to_16_1,wi,m_allocator);
-        if(res==nullptr) {
-            m_deallocator(wi);
+    }
+    m_deallocator(wi);
+    return nullptr;
+    
+}
+voice_handle_t player::voice(unsigned short port, voice_function_t fn, void* state) {
+    if(fn==nullptr) {
+        return nullptr;
+    }
+    return player_add_voice(port, &m_first,fn,nullptr,state,1.0f,m_allocator);
+}
+float player::amplitude(voice_handle_t handle) const {
+    const voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr) {
+        return 0.0f;
+    }
+    return v->gain_target;
+}
+bool player::amplitude(voice_handle_t handle, float value) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr) {
+        return false;
+    }
+    v->gain_target = value;
+    return true;
+}
+float player::pan(voice_handle_t handle) const {
+    const voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr) {
+        return 0.0f;
+    }
+    return v->pan_target;
+}
+bool player::pan(voice_handle_t handle, float value) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr || value<-1.0f || value>1.0f) {
+        return false;
+    }
+    v->pan_target = value;
+    return true;
+}
+float player::frequency(voice_handle_t handle) const {
+    const voice_info_t* v = player_find_voice(m_first,handle);
+    if(v!=nullptr && v->mix_fn==fm_voice) {
+        return ((const fm_info_t*)v->fn_state)->frequency;
+    }
+    if(v==nullptr || !player_is_waveform(v)) {
+        return 0.0f;
+    }
+    return ((const waveform_info_t*)v->fn_state)->frequency;
+}
+bool player::frequency(voice_handle_t handle, float value) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v!=nullptr && v->mix_fn==fm_voice && value>=0.0f) {
+        player_fm_frequency((fm_info_t*)v->fn_state,value,m_sample_rate);
+        return true;
+    }
+    if(v==nullptr || !player_is_waveform(v) || value<0.0f) {
+        return false;
+    }
+    waveform_info_t* wi = (waveform_info_t*)v->fn_state;
+    wi->frequency = value;
+    wi->phase_delta_target = player_two_pi*value/(float)m_sample_rate;
+    return true;
+}
+bool player::envelope(voice_handle_t handle, 
+                    float attack, 
+                    float decay, 
+                    float sustain, 
+                    float release) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr || attack<0.0f || decay<0.0f || release<0.0f || sustain<0.0f) {
+        return false;
+    }
+    envelope_info_t* e = (envelope_info_t*)v->envelope;
+    if(e==nullptr) {
+        e = (envelope_info_t*)m_allocator(sizeof(envelope_info_t));
+        if(e==nullptr) {
+            return false;
         }
-        return res;
-    } else if(wi->channel_count==1 && wi->bit_depth==16 && m_channel_count==1 && m_bit_depth==16) {
-        voice_handle_t res = player_add_voice(port, &m_first,wav_voice_16_1_to_16_1,wi,m_allocator);
-        if(res==nullptr) {
-            m_deallocator(wi);
+        e->level = 0.0f;
+        v->envelope = e;
+    }
+    e->stop = false;
+    e->decay = (size_t)(decay*m_sample_rate);
+    e->sustain = sustain;
+    e->release = (size_t)(release*m_sample_rate);
+    player_envelope_segment(e,PLAYER_ENVELOPE_ATTACK,1.0f,(size_t)(attack*m_sample_rate),false);
+    return true;
+}
+bool player::ramp(voice_handle_t handle, 
+                float level, 
+                float seconds, 
+                bool exponential, 
+                bool stop) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr || seconds<0.0f || level<0.0f) {
+        return false;
+    }
+    envelope_info_t* e = (envelope_info_t*)v->envelope;
+    if(e==nullptr) {
+        e = (envelope_info_t*)m_allocator(sizeof(envelope_info_t));
+        if(e==nullptr) {
+            return false;
         }
-        return res;
-    } else if(wi->channel_count==2 && wi->bit_depth==16 && m_channel_count==1 && m_bit_depth==8) {
-        voice_handle_t res = player_add_voice(port, &m_first,wav_voice_16_2_to_8_1,wi,m_allocator);
-        if(res==nullptr) {
-            m_deallocator(wi);
+        e->level = 1.0f;
+        e->decay = 0;
+        e->sustain = 1.0f;
+        e->release = 0;
+        v->envelope = e;
+    }
+    e->stop = stop;
+    player_envelope_segment(e,PLAYER_ENVELOPE_RAMP,level,(size_t)(seconds*m_sample_rate),exponential);
+    return true;
+}
+bool player::release(voice_handle_t handle) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr) {
+        return false;
+    }
+    if(v->mix_fn==fm_voice && v->envelope==nullptr) {
+        // the operators release together, and the voice ends with the carrier
+        fm_info_t* fi = (fm_info_t*)v->fn_state;
+        if(fi->envelopes[0].release==0) {
+            return player_remove_voice(&m_first,handle,m_deallocator);
         }
-        return res;
-    } else if(wi->channel_count==1 && wi->bit_depth==16 && m_channel_count==1 && m_bit_depth==8) {
-        voice_handle_t res = player_add_voice(port, &m_first,wav_voice_16_1_to_8_1,wi,m_allocator);
-        if(res==nullptr) {
-            m_deallocator(wi);
+        for(size_t i = 0;i<fi->operator_count;++i) {
+            envelope_info_t* e = &fi->envelopes[i];
+            if(e->stage!=PLAYER_ENVELOPE_RELEASE && e->stage!=PLAYER_ENVELOPE_DONE) {
+                player_envelope_segment(e,PLAYER_ENVELOPE_RELEASE,0.0f,e->release,false);
+            }
         }
-        return res;
+        return true;
+    }
+    envelope_info_t* e = (envelope_info_t*)v->envelope;
+    if(e==nullptr || e->release==0) {
+        return player_remove_voice(&m_first,handle,m_deallocator);
+    }
+    if(e->stage!=PLAYER_ENVELOPE_RELEASE && e->stage!=PLAYER_ENVELOPE_DONE) {
+        player_envelope_segment(e,PLAYER_ENVELOPE_RELEASE,0.0f,e->release,false);
+    }
+    return true;
+}
+bool player::on_voice_finished(voice_handle_t handle, 
+                            player_on_voice_finished_callback cb, 
+                            void* state) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr) {
+        return false;
+    }
+    v->on_finished = cb;
+    v->on_finished_state = state;
+    return true;
+}
+bool player::stop(voice_handle_t handle) {
+    if(handle==nullptr) {
+        player_free_sequences(&m_sequences,&m_first,m_deallocator);
+        player_free_midis(&m_midi,&m_first,m_deallocator);
+        player_free_mods(&m_mods,&m_first,m_deallocator);
+    }
+    if(m_first==nullptr) {
+        return handle==nullptr;
+    }
+    if(handle==nullptr) {
+        while(m_first!=nullptr) {
+            player_remove_voice((voice_handle_t*)&m_first,(voice_handle_t)m_first,m_deallocator);
+        }
+        return m_first==nullptr;
+    }
+    bool result = player_remove_voice(&m_first,handle,m_deallocator);
+    return result;
+}
+bool player::stop_port(unsigned short port) {
+    bool result = player_remove_sequence(&m_sequences,port,&m_first,m_deallocator);
+    result = player_remove_midi(&m_midi,port,&m_first,m_deallocator) || result;
+    result = player_remove_mod(&m_mods,port,&m_first,m_deallocator) || result;
+    if(m_first==nullptr) {
+        return result;
+    }
+    return player_remove_port(&m_first,port,m_deallocator) || result;
+}
+bool player::sequence(unsigned short port, 
+                    const player_note_t* notes, 
+                    size_t note_count, 
+                    unsigned short steps, 
+                    float step_seconds, 
+                    bool loop, 
+                    size_t voices) {
+    if(notes==nullptr || note_count==0 || steps==0 || step_seconds<=0.0f || voices==0) {
+        return false;
+    }
+    sequence_info_t* seq = (sequence_info_t*)m_allocator(sizeof(sequence_info_t)+voices*sizeof(voice_info_t*));
+    if(seq==nullptr) {
+        return false;
+    }
+    seq->port = port;
+    seq->notes = notes;
+    seq->note_count = note_count;
+    seq->next_note = 0;
+    seq->steps = steps;
+    seq->step_frames = (double)step_seconds*m_sample_rate;
+    seq->origin = m_clock;
+    seq->loop = loop;
+    seq->voice_count = voices;
+    seq->voices = (voice_info_t**)(seq+1);
+    for(size_t i = 0;i<voices;++i) {
+        seq->voices[i] = (voice_info_t*)player_waveform(port,m_sample_rate,&m_first,sin_voice,0.0f,0.0f,m_allocator,m_deallocator);
+        if(seq->voices[i]==nullptr) {
+            seq->voice_count = i;
+            player_free_sequence(seq,&m_first,m_deallocator);
+            return false;
+        }
+        seq->voices[i]->pooled = true;
+        seq->voices[i]->start = player_never;
+        if(!player_pool_envelope(seq->voices[i],m_sample_rate,m_allocator)) {
+            seq->voice_count = i+1;
+            player_free_sequence(seq,&m_first,m_deallocator);
+            return false;
+        }
+    }
+    // the sequence already on the port keeps playing unless this one starts
+    player_remove_sequence(&m_sequences,port,&m_first,m_deallocator);
+    seq->next = (sequence_info_t*)m_sequences;
+    m_sequences = seq;
+    return true;
+}
+bool player::sequence_playing(unsigned short port) const {
+    const sequence_info_t* seq = (const sequence_info_t*)m_sequences;
+    while(seq!=nullptr && seq->port!=port) {
+        seq=seq->next;
+    }
+    return seq!=nullptr;
+}
+bool player::stop_sequence(unsigned short port) {
+    return player_remove_sequence(&m_sequences,port,&m_first,m_deallocator);
+}
+// triggers the notes of each sequence that start during the next block.
+// sequences that don't loop are freed once their last note is over
+void player::sequencer() {
+    const unsigned long long block_start = m_clock;
+    const unsigned long long block_end = block_start+m_frame_count;
+    sequence_info_t** ps = (sequence_info_t**)&m_sequences;
+    while(*ps!=nullptr) {
+        sequence_info_t* seq = *ps;
+        const double origin = (double)seq->origin;
+        while(true) {
+            if(seq->next_note>=seq->note_count) {
+                const unsigned long long pass_end = (unsigned long long)(origin+seq->steps*seq->step_frames+.5);
+                if(!seq->loop || pass_end>=block_end) {
+                    break;
+                }
+                seq->origin = pass_end;
+                seq->next_note = 0;
+                break;
+            }
+            const player_note_t& note = seq->notes[seq->next_note];
+            unsigned long long start = (unsigned long long)(origin+note.step*seq->step_frames+.5);
+            if(start>=block_end) {
+                break;
+            }
+            if(start<block_start) {
+                start = block_start;
+            }
+            const unsigned long long stop = (unsigned long long)(origin+(note.step+note.length)*seq->step_frames+.5);
+            voice_info_t* v = player_pool_voice(seq->voices,seq->voice_count,block_start);
+            if(v!=nullptr && stop>start) {
+                player_pool_play(v,note.note,note.waveform,note.velocity/255.0f,start,stop,m_sample_rate);
+            }
+            ++seq->next_note;
+        }
+        if(seq->origin!=(unsigned long long)origin) {
+            // the sequence wrapped around, so trigger the start of the next pass
+            continue;
+        }
+        if(!seq->loop && seq->next_note>=seq->note_count) {
+            if(!player_pool_busy(seq->voices,seq->voice_count,block_start)) {
+                *ps = seq->next;
+                player_free_sequence(seq,&m_first,m_deallocator);
+                continue;
+            }
+        }
+        ps=&seq->next;
+    }
+}
+// sets up a MIDI file that has its source filled in and starts it playing
+bool player::midi_start(void* info, unsigned short port, float amplitude, bool loop, size_t voices) {
+    midi_info_t* mi = (midi_info_t*)info;
+    mi->port = port;
+    mi->stream_pos = 0;
+    mi->loop = loop;
+    mi->done = false;
+    mi->amplitude = amplitude;
+    mi->queue_head = 0;
+    mi->queue_count = 0;
+    for(int i = 0;i<16;++i) {
+        mi->waveform[i] = player_midi_program_waveforms[0];
+        mi->waveform_fixed[i] = false;
+        mi->volume[i] = 100;
+    }
+    mi->voice_count = 0;
+    mi->voices = (voice_info_t**)(mi+1);
+    mi->voice_keys = (unsigned short*)(mi->voices+voices);
+    if(!player_midi_open(mi)) {
+        m_deallocator(mi);
+        return false;
+    }
+    // the file starts on the next block
+    player_midi_rewind(mi,(double)m_clock,m_sample_rate);
+    for(size_t i = 0;i<voices;++i) {
+        mi->voices[i] = (voice_info_t*)player_waveform(port,m_sample_rate,&m_first,sin_voice,0.0f,0.0f,m_allocator,m_deallocator);
+        if(mi->voices[i]==nullptr) {
+            player_free_midi(mi,&m_first,m_deallocator);
+            return false;
+        }
+        ++mi->voice_count;
+        mi->voices[i]->pooled = true;
+        mi->voices[i]->start = player_never;
+        mi->voice_keys[i] = 0;
+        if(!player_pool_envelope(mi->voices[i],m_sample_rate,m_allocator)) {
+            player_free_midi(mi,&m_first,m_deallocator);
+            return false;
+        }
+    }
+    // the file already on the port keeps playing unless this one starts
+    player_remove_midi(&m_midi,port,&m_first,m_deallocator);
+    mi->next = (midi_info_t*)m_midi;
+    m_midi = mi;
+    return true;
+}
+bool player::midi(unsigned short port, 
+                player_on_read_stream_callback on_read_stream, 
+                void* on_read_stream_state, 
+                float amplitude, 
+                bool loop, 
+                player_on_seek_stream_callback on_seek_stream, 
+                void* on_seek_stream_state, 
+                size_t voices) {
+    if(on_read_stream==nullptr || voices==0 || amplitude<0.0f) {
+        return false;
+    }
+    if(loop && on_seek_stream==nullptr) {
+        return false;
+    }
+    midi_info_t* mi = player_midi_alloc(voices,m_allocator);
+    if(mi==nullptr) {
+        return false;
+    }
+    mi->on_read_stream = on_read_stream;
+    mi->on_read_stream_state = on_read_stream_state;
+    mi->on_seek_stream = on_seek_stream;
+    mi->on_seek_stream_state = on_seek_stream_state;
+    mi->data = nullptr;
+    mi->size = 0;
+    return midi_start(mi,port,amplitude,loop,voices);
+}
+bool player::midi(unsigned short port, 
+                const void* data, 
+                size_t size, 
+                float amplitude, 
+                bool loop, 
+                size_t voices) {
+    if(data==nullptr || voices==0 || amplitude<0.0f) {
+        return false;
+    }
+    midi_info_t* mi = player_midi_alloc(voices,m_allocator);
+    if(mi==nullptr) {
+        return false;
+    }
+    // memory is read through the stream functions with the file as their state
+    mi->on_read_stream = player_midi_memory_read;
+    mi->on_read_stream_state = mi;
+    mi->on_seek_stream = player_midi_memory_seek;
+    mi->on_seek_stream_state = mi;
+    mi->data = (const uint8_t*)data;
+    mi->size = size;
+    return midi_start(mi,port,amplitude,loop,voices);
+}
+bool player::midi_waveform(unsigned short port, unsigned char channel, player_waveform_t waveform) {
+    midi_info_t* mi = (midi_info_t*)m_midi;
+    while(mi!=nullptr && mi->port!=port) {
+        mi=mi->next;
+    }
+    if(mi==nullptr || channel>15 || waveform>PLAYER_WAVEFORM_TRI) {
+        return false;
+    }
+    mi->waveform[channel] = waveform;
+    mi->waveform_fixed[channel] = true;
+    return true;
+}
+bool player::midi_playing(unsigned short port) const {
+    const midi_info_t* mi = (const midi_info_t*)m_midi;
+    while(mi!=nullptr && mi->port!=port) {
+        mi=mi->next;
+    }
+    return mi!=nullptr;
+}
+bool player::stop_midi(unsigned short port) {
+    return player_remove_midi(&m_midi,port,&m_first,m_deallocator);
+}
+// parses the MIDI files up to the end of the next block and plays their
+// events. files are freed once they've finished and their notes are over
+void player::midi_events() {
+    const unsigned long long block_start = m_clock;
+    const unsigned long long block_end = block_start+m_frame_count;
+    midi_info_t** pm = (midi_info_t**)&m_midi;
+    while(*pm!=nullptr) {
+        midi_info_t* mi = *pm;
+        while(true) {
+            // keep the queue filled past the end of the block
+            while(!mi->done && mi->queue_count<PLAYER_MIDI_QUEUE) {
+                if(mi->queue_count>0 && mi->queue[(mi->queue_head+mi->queue_count-1)%PLAYER_MIDI_QUEUE].frame>=block_end) {
+                    break;
+                }
+                midi_event_t* ev = &mi->queue[(mi->queue_head+mi->queue_count)%PLAYER_MIDI_QUEUE];
+                if(player_midi_next(mi,ev,m_sample_rate)) {
+                    ++mi->queue_count;
+                    continue;
+                }
+                const double end = player_midi_end(mi);
+                // don't loop files with nothing in them forever
+                if(mi->loop && end>mi->pass_start) {
+                    player_midi_rewind(mi,end,m_sample_rate);
+                } else {
+                    mi->done = true;
+                }
+            }
+            while(mi->queue_count>0 && mi->queue[mi->queue_head].frame<block_end) {
+                if(!player_midi_play(mi,mi->queue[mi->queue_head],block_start,m_sample_rate)) {
+                    break;
+                }
+                mi->queue_head = (mi->queue_head+1)%PLAYER_MIDI_QUEUE;
+                --mi->queue_count;
+            }
+            // an empty queue means it filled up inside the block, so
+            // there may be more events to play before the block ends
+            if(mi->done || mi->queue_count>0) {
+                break;
+            }
+        }
+        if(mi->done && mi->queue_count==0 && !player_pool_busy(mi->voices,mi->voice_count,block_start)) {
+            *pm = mi->next;
+            player_free_midi(mi,&m_first,m_deallocator);
+            continue;
+        }
+        pm=&mi->next;
+    }
+}
+bool player::mod(unsigned short port, const void* data, size_t size, float amplitude, bool loop) {
+    if(data==nullptr || amplitude<0.0f) {
+        return false;
+    }
+    mod_info_t* mi = (mod_info_t*)m_allocator(sizeof(mod_info_t));
+    if(mi==nullptr) {
+        return false;
+    }
+    if(!player_mod_open(mi,(const uint8_t*)data,size)) {
+        m_deallocator(mi);
+        return false;
+    }
+    mi->port = port;
+    mi->order = 0;
+    mi->row = 0;
+    mi->tick = 0;
+    mi->speed = 6;
+    mi->tempo = 125;
+    // the module starts on the next block
+    mi->next_tick = (double)m_clock;
+    mi->jump_order = -1;
+    mi->break_row = -1;
+    mi->loop = loop;
+    mi->done = false;
+    mi->amplitude = amplitude;
+    memset(mi->channels,0,sizeof(mi->channels));
+    memset(mi->voices,0,sizeof(mi->voices));
+    for(size_t i = 0;i<mi->channel_count*2u;++i) {
+        sample_info_t* si = (sample_info_t*)m_allocator(sizeof(sample_info_t));
+        if(si==nullptr) {
+            player_free_mod(mi,&m_first,m_deallocator);
+            return false;
+        }
+        memset(si,0,sizeof(sample_info_t));
+        voice_info_t* v = (voice_info_t*)player_add_voice(port,&m_first,nullptr,sample_voice,si,0.0f,m_allocator);
+        if(v==nullptr) {
+            m_deallocator(si);
+            player_free_mod(mi,&m_first,m_deallocator);
+            return false;
+        }
+        v->pooled = true;
+        v->start = player_never;
+        mi->voices[i] = v;
+        if(!player_pool_envelope(v,m_sample_rate,m_allocator)) {
+            player_free_mod(mi,&m_first,m_deallocator);
+            return false;
+        }
+        // the Amiga's channels go left, right, right, left
+        const size_t channel = i/2;
+        v->pan = v->pan_target = ((channel&3)==0 || (channel&3)==3)?-.5f:.5f;
+    }
+    // the module already on the port keeps playing unless this one starts
+    player_remove_mod(&m_mods,port,&m_first,m_deallocator);
+    mi->next = (mod_info_t*)m_mods;
+    m_mods = mi;
+    return true;
+}
+bool player::mod_playing(unsigned short port) const {
+    const mod_info_t* mi = (const mod_info_t*)m_mods;
+    while(mi!=nullptr && mi->port!=port) {
+        mi=mi->next;
+    }
+    return mi!=nullptr;
+}
+bool player::stop_mod(unsigned short port) {
+    return player_remove_mod(&m_mods,port,&m_first,m_deallocator);
+}
+// runs the ticks of each module that start during the next block. modules
+// are freed once they've ended and their notes are over
+void player::mod_ticks() {
+    const unsigned long long block_start = m_clock;
+    const unsigned long long block_end = block_start+m_frame_count;
+    mod_info_t** pm = (mod_info_t**)&m_mods;
+    while(*pm!=nullptr) {
+        mod_info_t* mi = *pm;
+        while(!mi->done && mi->next_tick<block_end) {
+            unsigned long long frame = (unsigned long long)(mi->next_tick+.5);
+            if(frame<block_start) {
+                frame = block_start;
+            }
+            if(mi->tick==0) {
+                player_mod_row(mi,frame,m_sample_rate);
+            } else {
+                player_mod_effects(mi,m_sample_rate);
+            }
+            mi->next_tick+=player_mod_tick_frames(mi->tempo,m_sample_rate);
+            if(!player_mod_advance(mi)) {
+                // the last row plays out its ticks before the notes stop
+                mi->done = true;
+                const unsigned long long end = (unsigned long long)(mi->next_tick+.5);
+                for(size_t i = 0;i<mi->channel_count*2u;++i) {
+                    player_pool_stop(mi->voices[i],end);
+                }
+            }
+        }
+        if(mi->done && !player_pool_busy(mi->voices,mi->channel_count*2,block_start)) {
+            *pm = mi->next;
+            player_free_mod(mi,&m_first,m_deallocator);
+            continue;
+        }
+        pm=&mi->next;
+    }
+}
+unsigned long long player::frame_clock() const {
+    return m_clock;
+}
+bool player::start_at(voice_handle_t handle, unsigned long long frame) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr) {
+        return false;
+    }
+    v->start = frame;
+    return true;
+}
+bool player::stop_at(voice_handle_t handle, unsigned long long frame) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr) {
+        return false;
+    }
+    v->stop = frame;
+    return true;
+}
+bool player::position(voice_handle_t handle, unsigned long long* out_frame) const {
+    const voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr || out_frame==nullptr) {
+        return false;
+    }
+    const wav_info_t* wi = player_voice_wav(v);
+    if(wi!=nullptr) {
+        *out_frame = wi->pos/(wi->channel_count*2);
+    } else {
+        *out_frame = v->played;
+    }
+    return true;
+}
+bool player::remaining(voice_handle_t handle, unsigned long long* out_frames) const {
+    const voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr || out_frames==nullptr) {
+        return false;
+    }
+    unsigned long long result = player_never;
+    const wav_info_t* wi = player_voice_wav(v);
+    if(wi!=nullptr && !wi->loop) {
+        result = wi->pos<wi->length?(wi->length-wi->pos)/(wi->channel_count*2):0;
+    }
+    if(v->stop!=player_never) {
+        // a voice that hasn't started yet has all of its scheduled time left
+        const unsigned long long from = v->start>m_clock?v->start:m_clock;
+        const unsigned long long scheduled = v->stop>from?v->stop-from:0;
+        if(scheduled<result) {
+            result = scheduled;
+        }
+    }
+    if(result==player_never) {
+        return false;
+    }
+    *out_frames = result;
+    return true;
+}
+size_t player::sink_latency() const {
+    return m_sink_latency;
+}
+void player::sink_latency(size_t frames) {
+    m_sink_latency = frames;
+}
+unsigned long long player::latency() const {
+    // the block being rendered, plus the limiter's look-ahead block
+    unsigned long long result = m_frame_count;
+    if(m_limiter) {
+        result+=m_frame_count;
+    }
+    return result+m_sink_latency;
+}
+float player::port_gain(unsigned short port) const {
+    const port_info_t* p = player_find_port(m_ports,port);
+    if(p==nullptr) {
+        return 1.0f;
     }
-    m_deallocator(wi);
-    return nullptr;
-    
+    return p->gain;
 }
-voice_handle_t player::voice(unsigned short port, voice_function_t fn, void* state) {
-    if(fn==nullptr) {
-        return nullptr;
+bool player::port_gain(unsigned short port, float value) {
+    if(value<0.0f) {
+        return false;
+    }
+    port_info_t* p = player_get_port(&m_ports,port,m_allocator);
+    if(p==nullptr) {
+        return false;
     }
-    return player_add_voice(port, &m_first,fn,state,m_allocator);
+    p->gain = value;
+    return true;
 }
-bool player::stop(voice_handle_t handle) {
-    if(m_first==nullptr) {
-        return handle==nullptr;
+bool player::port_mute(unsigned short port) const {
+    const port_info_t* p = player_find_port(m_ports,port);
+    if(p==nullptr) {
+        return false;
     }
-    if(handle==nullptr) {
-        while(m_first!=nullptr) {
-            player_remove_voice((voice_handle_t*)&m_first,(voice_handle_t)m_first,m_deallocator);
+    return p->mute;
+}
+bool player::port_mute(unsigned short port, bool value) {
+    port_info_t* p = player_get_port(&m_ports,port,m_allocator);
+    if(p==nullptr) {
+        return false;
+    }
+    p->mute = value;
+    return true;
+}
+bool player::port_solo(unsigned short port) const {
+    const port_info_t* p = player_find_port(m_ports,port);
+    if(p==nullptr) {
+        return false;
+    }
+    return p->solo;
+}
+bool player::port_solo(unsigned short port, bool value) {
+    port_info_t* p = player_get_port(&m_ports,port,m_allocator);
+    if(p==nullptr) {
+        return false;
+    }
+    p->solo = value;
+    return true;
+}
+bool player::filter(voice_handle_t handle, 
+                    size_t stage, 
+                    player_filter_t type, 
+                    float frequency, 
+                    float q, 
+                    float gain) {
+    voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr) {
+        return false;
+    }
+    return player_filter_set(&v->filters,stage,type,frequency,q,gain,m_allocator);
+}
+bool player::port_filter(unsigned short port, 
+                        size_t stage, 
+                        player_filter_t type, 
+                        float frequency, 
+                        float q, 
+                        float gain) {
+    port_info_t* p = player_get_port(&m_ports,port,m_allocator);
+    if(p==nullptr) {
+        return false;
+    }
+    return player_filter_set(&p->filters,stage,type,frequency,q,gain,m_allocator);
+}
+bool player::master_filter(size_t stage, 
+                        player_filter_t type, 
+                        float frequency, 
+                        float q, 
+                        float gain) {
+    return player_filter_set(&m_filters,stage,type,frequency,q,gain,m_allocator);
+}
+float player::port_send(unsigned short port) const {
+    const port_info_t* p = player_find_port(m_ports,port);
+    if(p==nullptr) {
+        return 0.0f;
+    }
+    return p->send;
+}
+bool player::port_send(unsigned short port, float value) {
+    if(value<0.0f) {
+        return false;
+    }
+    port_info_t* p = player_get_port(&m_ports,port,m_allocator);
+    if(p==nullptr) {
+        return false;
+    }
+    p->send = value;
+    return true;
+}
+bool player::send_delay(float seconds, float feedback, float level) {
+    if(seconds<=0.0f || level==0.0f) {
+        effects_info_t* fx = (effects_info_t*)m_effects;
+        if(fx!=nullptr && fx->delay_line!=nullptr) {
+            m_deallocator(fx->delay_line);
+            fx->delay_line = nullptr;
+            player_trim_effects(&m_effects,m_deallocator);
         }
-        return m_first==nullptr;
+        return true;
     }
-    bool result = player_remove_voice(&m_first,handle,m_deallocator);
-    return result;
+    if(feedback<0.0f || feedback>=1.0f || level<0.0f || m_sample_rate==0) {
+        return false;
+    }
+    const size_t length = (size_t)(seconds*m_sample_rate);
+    if(length==0) {
+        return false;
+    }
+    effects_info_t* fx = player_get_effects(&m_effects,m_allocator);
+    if(fx==nullptr) {
+        return false;
+    }
+    if(fx->delay_line==nullptr || fx->delay_length!=length) {
+        float* line = (float*)m_allocator(length*sizeof(float));
+        if(line==nullptr) {
+            player_trim_effects(&m_effects,m_deallocator);
+            return false;
+        }
+        memset(line,0,length*sizeof(float));
+        if(fx->delay_line!=nullptr) {
+            m_deallocator(fx->delay_line);
+        }
+        fx->delay_line = line;
+        fx->delay_length = length;
+        fx->delay_pos = 0;
+    }
+    fx->delay_feedback = feedback;
+    fx->delay_level = level;
+    return true;
 }
-bool player::stop_port(unsigned short port) {
-    if(m_first==nullptr) {
+bool player::send_reverb(float size, float damping, float level) {
+    if(level==0.0f) {
+        effects_info_t* fx = (effects_info_t*)m_effects;
+        if(fx!=nullptr && fx->reverb_lines!=nullptr) {
+            m_deallocator(fx->reverb_lines);
+            fx->reverb_lines = nullptr;
+            player_trim_effects(&m_effects,m_deallocator);
+        }
+        return true;
+    }
+    if(size<0.0f || size>1.0f || damping<0.0f || damping>1.0f || level<0.0f || m_sample_rate==0) {
         return false;
     }
-    return player_remove_port(&m_first,port,m_deallocator);
+    effects_info_t* fx = player_get_effects(&m_effects,m_allocator);
+    if(fx==nullptr) {
+        return false;
+    }
+    if(fx->reverb_lines==nullptr) {
+        // the lines are scaled from their 44.1kHz lengths to the current rate
+        size_t comb_length[PLAYER_REVERB_COMBS];
+        size_t allpass_length[2][PLAYER_REVERB_ALLPASSES];
+        size_t total = 0;
+        for(size_t c = 0;c<PLAYER_REVERB_COMBS;++c) {
+            comb_length[c] = (player_reverb_comb_tuning[c]*m_sample_rate)/44100+1;
+            total+=comb_length[c];
+        }
+        for(size_t j = 0;j<2;++j) {
+            for(size_t a = 0;a<PLAYER_REVERB_ALLPASSES;++a) {
+                allpass_length[j][a] = ((player_reverb_allpass_tuning[a]+j*player_reverb_spread)*m_sample_rate)/44100+1;
+                total+=allpass_length[j][a];
+            }
+        }
+        float* lines = (float*)m_allocator(total*sizeof(float));
+        if(lines==nullptr) {
+            player_trim_effects(&m_effects,m_deallocator);
+            return false;
+        }
+        memset(lines,0,total*sizeof(float));
+        fx->reverb_lines = lines;
+        for(size_t c = 0;c<PLAYER_REVERB_COMBS;++c) {
+            fx->comb[c] = lines;
+            fx->comb_length[c] = comb_length[c];
+            fx->comb_pos[c] = 0;
+            fx->comb_store[c] = 0.0f;
+            lines+=comb_length[c];
+        }
+        for(size_t j = 0;j<2;++j) {
+            for(size_t a = 0;a<PLAYER_REVERB_ALLPASSES;++a) {
+                fx->allpass[j][a] = lines;
+                fx->allpass_length[j][a] = allpass_length[j][a];
+                fx->allpass_pos[j][a] = 0;
+                lines+=allpass_length[j][a];
+            }
+        }
+    }
+    // freeverb's room size and damping scales
+    fx->reverb_feedback = size*.28f+.7f;
+    fx->reverb_damping = damping*.4f;
+    fx->reverb_level = level*3.0f;
+    return true;
 }
 void player::on_sound_disable(player_on_sound_disable_callback cb, void* state) {
     m_on_sound_disable_cb = cb;
@@ -939,17 +4080,71 @@ void player::on_flush(player_on_flush_callback cb, void* state) {
     m_on_flush_cb = cb;
     m_on_flush_state = state;
 }
+void player::on_acquire_buffer(player_on_acquire_buffer_callback cb, void* state) {
+    m_on_acquire_buffer_cb = cb;
+    m_on_acquire_buffer_state = state;
+}
+void player::on_commit_buffer(player_on_commit_buffer_callback cb, void* state) {
+    m_on_commit_buffer_cb = cb;
+    m_on_commit_buffer_state = state;
+}
+void player::on_deadline_miss(player_on_deadline_miss_callback cb, void* state) {
+    m_on_deadline_miss_cb = cb;
+    m_on_deadline_miss_state = state;
+}
 bool player::realloc_buffer() {
     size_t new_size = m_frame_count * m_channel_count * (m_bit_depth/8);
     if(new_size==0) {
         deinitialize();
         return true;
     }
-    void* resized = m_reallocator(m_buffer,new_size);
-    if(resized==nullptr) {
+    if(m_buffer_external!=nullptr && new_size>m_buffer_external_size) {
+        return false;
+    }
+    if(m_buffer==nullptr) {
+        // not initialized yet. the buffers get sized on initialize()
+        return true;
+    }
+    // realloc() can't keep the alignment, and the contents don't need 
+    // to survive, so new buffers are allocated and swapped in once they 
+    // all succeed
+    const size_t mix_size = m_frame_count*m_channel_count*sizeof(float);
+    void* buffer = m_buffer_external;
+    if(buffer==nullptr) {
+        buffer = player_aligned_alloc(new_size,m_allocator);
+    }
+    void* scratch = player_aligned_alloc(m_frame_count*m_channel_count*(player_voice_bit_depth(m_format)/8),m_allocator);
+    float* mix = (float*)player_aligned_alloc(mix_size,m_allocator);
+    float* bus = (float*)player_aligned_alloc(mix_size,m_allocator);
+    float* voice_mix = (float*)player_aligned_alloc(mix_size,m_allocator);
+    float* send = (float*)player_aligned_alloc(m_frame_count*sizeof(float),m_allocator);
+    float* limiter_delay = nullptr;
+    if(m_limiter) {
+        limiter_delay = (float*)player_aligned_alloc(mix_size,m_allocator);
+    }
+    if(buffer==nullptr || scratch==nullptr || mix==nullptr || bus==nullptr || voice_mix==nullptr || send==nullptr || (m_limiter && limiter_delay==nullptr)) {
+        if(buffer!=m_buffer_external) {
+            player_aligned_free(buffer,m_deallocator);
+        }
+        player_aligned_free(scratch,m_deallocator);
+        player_aligned_free(mix,m_deallocator);
+        player_aligned_free(bus,m_deallocator);
+        player_aligned_free(voice_mix,m_deallocator);
+        player_aligned_free(send,m_deallocator);
+        player_aligned_free(limiter_delay,m_deallocator);
         return false;
     }
-    m_buffer = resized;
+    free_buffers();
+    m_buffer = buffer;
+    m_buffer_silent = false;
+    m_scratch = scratch;
+    m_mix = mix;
+    m_bus = bus;
+    m_voice_mix = voice_mix;
+    m_send = send;
+    m_limiter_delay = limiter_delay;
+    limiter_reset();
+    m_sample_max = (1U<<player_voice_bit_depth(m_format))-1;
     return true;
 }
 size_t player::frame_count() const {
@@ -1000,14 +4195,32 @@ unsigned short player::bit_depth() const {
     return m_bit_depth;
 }
 bool player::bit_depth(unsigned short value) {
-    if(value==0) {
+    if(value==m_bit_depth) {
+        return true;
+    }
+    // plain bit depths select the unsigned formats
+    if(value==8) {
+        return format(PLAYER_FORMAT_U8);
+    } else if(value==16) {
+        return format(PLAYER_FORMAT_U16);
+    }
+    return false;
+}
+player_format_t player::format() const {
+    return m_format;
+}
+bool player::format(player_format_t value) {
+    if(value<PLAYER_FORMAT_U8 || value>PLAYER_FORMAT_F32) {
         return false;
     }
-    if(value!=m_bit_depth) {
-        unsigned int tmp = m_bit_depth;
-        m_bit_depth = value;
+    if(value!=m_format) {
+        const player_format_t old_format = m_format;
+        const unsigned int old_bit_depth = m_bit_depth;
+        m_format = value;
+        m_bit_depth = player_format_bit_depth(value);
         if(!realloc_buffer()) {
-            m_bit_depth = tmp;
+            m_format = old_format;
+            m_bit_depth = old_bit_depth;
             return false;
         }
     }
@@ -1016,25 +4229,436 @@ bool player::bit_depth(unsigned short value) {
 size_t player::buffer_size() const {
     return m_frame_count*m_channel_count*(m_bit_depth/8);
 }
-void player::update() {
-    const size_t buffer_size = m_frame_count*m_channel_count*(m_bit_depth/8);
-    voice_info_t* first = (voice_info_t*)m_first;
-    bool has_voices = false;
+void* player::buffer() const {
+    return m_buffer;
+}
+bool player::buffer(void* buffer, size_t size) {
+    if(buffer!=nullptr) {
+        if(((uintptr_t)buffer&(PLAYER_BUFFER_ALIGNMENT-1))!=0 || size<buffer_size()) {
+            return false;
+        }
+    } else if(m_buffer!=nullptr && m_buffer==m_buffer_external) {
+        // going back to our own buffer
+        void* internal = player_aligned_alloc(buffer_size(),m_allocator);
+        if(internal==nullptr) {
+            return false;
+        }
+        m_buffer = internal;
+    }
+    if(m_buffer!=nullptr && buffer!=nullptr) {
+        if(m_buffer!=m_buffer_external) {
+            player_aligned_free(m_buffer,m_deallocator);
+        }
+        m_buffer = buffer;
+    }
+    m_buffer_external = buffer;
+    m_buffer_external_size = buffer==nullptr?0:size;
+    m_buffer_silent = false;
+    return true;
+}
+bool player::mix() {
+    const size_t sample_count = m_frame_count*m_channel_count;
+    const size_t scratch_size = sample_count*(player_voice_bit_depth(m_format)/8);
+    voice_info_t* v = (voice_info_t*)m_first;
+    port_info_t* pi = (port_info_t*)m_ports;
+    bool solo = false;
+    while(pi!=nullptr) {
+        if(pi->solo) {
+            solo = true;
+            break;
+        }
+        pi=pi->next;
+    }
+    pi = (port_info_t*)m_ports;
+#ifdef PLAYER_INSTRUMENTATION
+    const unsigned long deadline = block_deadline();
+#endif
+    // the block covers [block_start,block_end) on the player's clock
+    const unsigned long long block_start = m_clock;
+    const unsigned long long block_end = block_start+m_frame_count;
+    mix_function_info_t minf;
+    minf.channel_count = m_channel_count;
     voice_function_info_t vinf;
-    vinf.buffer = m_buffer;
-    vinf.frame_count = m_frame_count;
+    vinf.buffer = m_scratch;
     vinf.channel_count = m_channel_count;
-    vinf.bit_depth = m_bit_depth;
+    vinf.bit_depth = player_voice_bit_depth(m_format);
     vinf.sample_max = m_sample_max;
-    voice_info_t* v = first;
-    memset(m_buffer,0,buffer_size);
-    if(m_auto_disable) {
-        while(v!=nullptr) {
-            has_voices = true;
-            v->fn(vinf, v->fn_state);
+    bool finished = false;
+    bool audible_block = false;
+    // nothing clears the buffers. the first voice to write one each
+    // block stores into it and the rest add to it
+    bool mix_written = false;
+    effects_info_t* fx = (effects_info_t*)m_effects;
+    bool send_written = false;
+    while(v!=nullptr) {
+        // voices are sorted by port, so each run of voices is one port's submix
+        const unsigned short port = v->port;
+        while(pi!=nullptr && pi->port<port) {
+            pi=pi->next;
+        }
+        float gain = 1.0f;
+        bool audible = !solo;
+        filter_info_t* port_filters = nullptr;
+        float send = 0.0f;
+        if(pi!=nullptr && pi->port==port) {
+            gain = pi->gain;
+            audible = !pi->mute && (!solo || pi->solo);
+            port_filters = (filter_info_t*)pi->filters;
+            if(fx!=nullptr) {
+                send = pi->send;
+            }
+        }
+        if(gain==0.0f) {
+            audible = false;
+        }
+        // unity gain ports mix straight into the master. the rest, and
+        // filtered or sending ports, get their own bus so the gain, filters 
+        // and send are applied once per sample. voices on ports that can't 
+        // be heard only advance
+        float* bus = m_mix;
+        bool bus_written = mix_written;
+        if(!audible) {
+            bus = nullptr;
+        } else if(gain!=1.0f || port_filters!=nullptr || send!=0.0f) {
+            bus = m_bus;
+            bus_written = false;
+        }
+        // where a voice that is rendered in parts picks up
+        size_t resume_frame = 0;
+        do {
+            // scheduled voices only render the part of the block between
+            // their start and stop, so their timing is exact to the frame
+            if(v->start>=block_end) {
+                v=v->next;
+                continue;
+            }
+            if(v->stop<=block_start || v->stop<=v->start) {
+                if(v->pooled) {
+                    v->start = player_never;
+                    v=v->next;
+                    continue;
+                }
+                v->finished = true;
+                finished = true;
+                v=v->next;
+                continue;
+            }
+            size_t first_frame = v->start>block_start?(size_t)(v->start-block_start):0;
+            if(first_frame<resume_frame) {
+                first_frame = resume_frame;
+            }
+            size_t end_frame = v->stop<block_end?(size_t)(v->stop-block_start):m_frame_count;
+            // pool notes fade out so they end on their stop frame. a fade
+            // that starts partway through the block is rendered separately
+            bool fade_next = false;
+            if(v->pooled && v->envelope!=nullptr) {
+                envelope_info_t* e = (envelope_info_t*)v->envelope;
+                if(e->stage!=PLAYER_ENVELOPE_RELEASE && e->stage!=PLAYER_ENVELOPE_DONE && v->stop<e->release+block_end) {
+                    // short notes fade out over their second half
+                    const unsigned long long half = (v->stop-v->start)/2;
+                    const unsigned long long fade = v->stop-(half<e->release?half:e->release);
+                    if(fade>block_start+first_frame && fade<block_end && fade<v->stop) {
+                        end_frame = (size_t)(fade-block_start);
+                        fade_next = true;
+                    } else if(fade<=block_start+first_frame) {
+                        player_envelope_segment(e,PLAYER_ENVELOPE_RELEASE,0.0f,(size_t)(v->stop-(block_start+first_frame)),false);
+                    }
+                }
+            }
+            const size_t frame_count = end_frame-first_frame;
+            if(end_frame<m_frame_count && !v->pooled) {
+                v->finished = true;
+                finished = true;
+            }
+            minf.frame_count = frame_count;
+            vinf.frame_count = frame_count;
+            // ramp the gain across the block so changes don't zipper.
+            // the envelope and panning are folded into the same per channel gain
+            float gain_start = v->gain;
+            float gain_end = v->gain_target;
+            if(v->envelope!=nullptr) {
+                envelope_info_t* e = (envelope_info_t*)v->envelope;
+                gain_start*=e->level;
+                gain_end*=player_envelope_advance(e,frame_count);
+                if(e->stage==PLAYER_ENVELOPE_DONE && !v->pooled) {
+                    v->finished = true;
+                    finished = true;
+                }
+            }
+            if(m_channel_count==1) {
+                minf.gain[0] = minf.gain[1] = gain_start;
+                minf.gain_step[0] = minf.gain_step[1] = (gain_end-gain_start)/frame_count;
+            } else {
+                float left, right;
+                const bool balance = v->mix_fn==wav_voice_16_2_to_2;
+                player_pan_gains(v->pan,balance,&left,&right);
+                minf.gain[0] = gain_start*left;
+                minf.gain[1] = gain_start*right;
+                if(v->pan!=v->pan_target) {
+                    player_pan_gains(v->pan_target,balance,&left,&right);
+                    v->pan = v->pan_target;
+                }
+                minf.gain_step[0] = (gain_end*left-minf.gain[0])/frame_count;
+                minf.gain_step[1] = (gain_end*right-minf.gain[1])/frame_count;
+            }
+            v->gain = v->gain_target;
+            // a voice with no gain for the whole block would only produce silence
+            const bool silent = gain_start==0.0f && gain_end==0.0f;
+            float* voice_bus = silent?nullptr:bus;
+            // filtered voices render alone so the filters only see them
+            filter_info_t* voice_filters = voice_bus!=nullptr?(filter_info_t*)v->filters:nullptr;
+            minf.buffer = voice_filters!=nullptr?m_voice_mix:voice_bus;
+            minf.assign = voice_filters!=nullptr || !bus_written;
+            if(frame_count!=m_frame_count && minf.buffer!=nullptr) {
+                // the rest of the block has to be there too
+                if(minf.assign) {
+                    memset(minf.buffer,0,sample_count*sizeof(float));
+                    minf.assign = false;
+                }
+                minf.buffer+=first_frame*m_channel_count;
+            }
+            PLAYER_TIMING_START(voice_start);
+            if(v->mix_fn!=nullptr) {
+                switch(v->mix_fn(minf, v->fn_state)) {
+                    case PLAYER_MIX_DONE:
+                        if(v->pooled) {
+                            v->start = player_never;
+                        } else {
+                            v->finished = true;
+                            finished = true;
+                        }
+                        // the final block may still have had sound in it
+                        audible_block|=minf.buffer!=nullptr;
+                        break;
+                    case PLAYER_MIX_SOUND:
+                        audible_block = true;
+                        break;
+                    default:
+                        break;
+                }
+            } else {
+                // custom voices can't skip, so they render and get discarded
+                memset(m_scratch,0,scratch_size);
+                v->fn(vinf, v->fn_state);
+                if(minf.buffer!=nullptr) {
+                    if(minf.assign) {
+                        player_pcm_to_mix<true>(m_scratch,minf.buffer,minf,vinf.bit_depth);
+                    } else {
+                        player_pcm_to_mix<false>(m_scratch,minf.buffer,minf,vinf.bit_depth);
+                    }
+                    audible_block = true;
+                }
+            }
+            if(voice_filters!=nullptr) {
+                player_filter_process(voice_filters,m_voice_mix,m_frame_count,m_channel_count,m_sample_rate);
+                player_bus_add(voice_bus,m_voice_mix,sample_count,1.0f,!bus_written);
+            }
+            bus_written|=voice_bus!=nullptr;
+            PLAYER_TIMING_RECORD(&v->timing,voice_start,deadline);
+            v->played+=frame_count;
+            if(fade_next && v->start!=player_never) {
+                // go around again for the rest of the block
+                resume_frame = end_frame;
+                continue;
+            }
+            resume_frame = 0;
             v=v->next;
+        } while(v!=nullptr && v->port==port);
+        if(bus==m_mix) {
+            mix_written = bus_written;
+        } else if(bus==m_bus && bus_written) {
+            if(port_filters!=nullptr) {
+                player_filter_process(port_filters,m_bus,m_frame_count,m_channel_count,m_sample_rate);
+            }
+            player_bus_add(m_mix,m_bus,sample_count,gain,!mix_written);
+            mix_written = true;
+            if(send!=0.0f) {
+                player_send_add(m_send,m_bus,m_frame_count,m_channel_count,gain*send,!send_written);
+                send_written = true;
+            }
+        }
+    }
+    // the effects return keeps running after the sends stop until
+    // the tails die away
+    if(fx!=nullptr && (send_written || !fx->idle)) {
+        fx->idle = false;
+        if(player_effects_process(fx,send_written?m_send:nullptr,m_mix,m_frame_count,m_channel_count,!mix_written)) {
+            audible_block = true;
+        }
+        mix_written = true;
+    }
+    if(mix_written && m_filters!=nullptr) {
+        player_filter_process((filter_info_t*)m_filters,m_mix,m_frame_count,m_channel_count,m_sample_rate);
+    }
+    if(finished) {
+        player_remove_finished(&m_first,m_deallocator);
+    }
+    return audible_block;
+}
+// clears the limiter's history
+void player::limiter_reset() {
+    m_limiter_gain = 1.0f;
+    m_limiter_peak = 0.0f;
+    if(m_limiter_delay!=nullptr) {
+        memset(m_limiter_delay,0,m_frame_count*m_channel_count*sizeof(float));
+    }
+}
+// the limiter delays the mix by one block, so the gain for each block 
+// is known from both the block going out and the one coming in. the 
+// gain ramps across the block between two values that are each low 
+// enough for every sample in it, so no sample can exceed the threshold.
+// returns true if there was sound in either block
+bool player::limit(bool audible) {
+    const size_t sample_count = m_frame_count*m_channel_count;
+    if(!audible) {
+        if(m_limiter_peak==0.0f) {
+            // both blocks are silent, so there's nothing to do
+            return false;
+        }
+        memset(m_mix,0,sample_count*sizeof(float));
+    }
+    float* mix = m_mix;
+    float* delay = m_limiter_delay;
+    const float peak = player_peak(mix,sample_count);
+    const float window_peak = peak>m_limiter_peak?peak:m_limiter_peak;
+    float gain = 1.0f;
+    if(window_peak>m_limiter_threshold) {
+        gain = m_limiter_threshold/window_peak;
+    }
+    if(gain>m_limiter_gain) {
+        // recover towards unity at the release rate, but no further than allowed
+        const float release = 1.0f-expf(-(float)m_frame_count/(m_limiter_release*m_sample_rate));
+        const float released = m_limiter_gain+(1.0f-m_limiter_gain)*release;
+        gain = released<gain?released:gain;
+    }
+    const float gain_start = m_limiter_gain;
+    const float gain_step = (gain-gain_start)/m_frame_count;
+    // the gain is computed from the frame index rather than accumulated
+    // so the loops vectorize
+    const int frame_count = (int)m_frame_count;
+    if(m_channel_count==1) {
+        for(int i = 0;i<frame_count;++i) {
+            const float f = mix[i];
+            mix[i] = delay[i]*(gain_start+gain_step*(float)i);
+            delay[i] = f;
+        }
+    } else if(m_channel_count==2) {
+        for(int i = 0;i<frame_count;++i) {
+            const float g = gain_start+gain_step*(float)i;
+            const float left = mix[i*2];
+            const float right = mix[i*2+1];
+            mix[i*2] = delay[i*2]*g;
+            mix[i*2+1] = delay[i*2+1]*g;
+            delay[i*2] = left;
+            delay[i*2+1] = right;
+        }
+    } else {
+        for(int i = 0;i<frame_count;++i) {
+            const float g = gain_start+gain_step*(float)i;
+            for(unsigned int j = 0;j<m_channel_count;++j) {
+                const float f = *mix;
+                *mix++ = *delay*g;
+                *delay++ = f;
+            }
+        }
+    }
+    const bool result = m_limiter_peak!=0.0f;
+    m_limiter_gain = gain;
+    m_limiter_peak = peak;
+    return result;
+}
+// converts the block into the buffer that gets sent to the output. that is
+// the buffer acquired from the sink when there is one, otherwise m_buffer,
+// where silence is only written again after a block with sound in it
+void* player::output(bool audible, void* acquired) {
+    const size_t sample_count = m_frame_count*m_channel_count;
+    void* dst = m_buffer;
+    if(acquired!=nullptr) {
+        dst = acquired;
+    } else if(!audible) {
+        if(!m_buffer_silent) {
+            player_fill_silence(dst,sample_count,m_format);
+            m_buffer_silent = true;
+        }
+        return dst;
+    } else {
+        m_buffer_silent = false;
+    }
+    if(audible) {
+        player_mix_to_pcm(m_mix,dst,sample_count,m_format);
+    } else {
+        player_fill_silence(dst,sample_count,m_format);
+    }
+    return dst;
+}
+void player::check_deadline() {
+    const player_ticks_t now = player_ticks();
+    if(m_last_update_valid && m_sample_rate!=0) {
+        const player_ticks_t elapsed = (player_ticks_t)(now-(player_ticks_t)m_last_update);
+        const unsigned long long tps = player_ticks_per_second();
+        const unsigned long long period = (m_frame_count*tps)/m_sample_rate;
+        const unsigned long long limit = period+(unsigned long long)(period*m_deadline_tolerance);
+        if(elapsed>limit) {
+            const unsigned long lateness = (unsigned long)(((elapsed-period)*1000000ULL)/tps);
+            ++m_late_blocks;
+            m_total_lateness+=lateness;
+            if(lateness>m_max_lateness) {
+                m_max_lateness = lateness;
+            }
+            if(m_on_deadline_miss_cb!=nullptr) {
+                m_on_deadline_miss_cb(lateness,m_on_deadline_miss_state);
+            }
+        }
+    }
+    m_last_update = now;
+    m_last_update_valid = true;
+}
+void player::update() {
+    const size_t buffer_size = m_frame_count*m_channel_count*(m_bit_depth/8);
+    // the sink's buffer is borrowed before anything is rendered. when it
+    // has no room the block isn't rendered and the clock doesn't move, so
+    // the next update() renders it instead
+    void* acquired = nullptr;
+    if(m_on_acquire_buffer_cb!=nullptr) {
+        acquired = m_on_acquire_buffer_cb(buffer_size,m_on_acquire_buffer_state);
+        if(acquired==nullptr) {
+            return;
         }
-        if(has_voices) {
+    }
+    const bool has_sink = m_on_flush_cb!=nullptr || m_on_acquire_buffer_cb!=nullptr;
+    // only time blocks that follow one that was actually sent
+    if(m_sound_enabled && has_sink) {
+        check_deadline();
+    } else {
+        m_last_update_valid = false;
+    }
+#ifdef PLAYER_INSTRUMENTATION
+    const unsigned long deadline = block_deadline();
+#endif
+    if(m_sequences!=nullptr) {
+        sequencer();
+    }
+    if(m_midi!=nullptr) {
+        midi_events();
+    }
+    if(m_mods!=nullptr) {
+        mod_ticks();
+    }
+    voice_info_t* first = (voice_info_t*)m_first;
+    bool audible = false;
+    PLAYER_TIMING_START(render_start);
+    const effects_info_t* fx = (const effects_info_t*)m_effects;
+    const bool ringing = fx!=nullptr && !fx->idle;
+    if(first!=nullptr || ringing) {
+        audible = mix();
+    }
+    if(m_limiter_delay!=nullptr) {
+        audible = limit(audible);
+    }
+    if(m_auto_disable) {
+        // a block where every voice was silent turns the output off
+        // just like having no voices does
+        if(audible) {
             if(!m_sound_enabled) {
                 if(m_on_sound_enable_cb!=nullptr) {
                     m_on_sound_enable_cb(m_on_sound_enable_state);
@@ -1049,45 +4673,109 @@ void player::update() {
                 m_sound_enabled = false;
             }
         }
-        if(m_sound_enabled && m_on_flush_cb!=nullptr) {
-            m_on_flush_cb(m_buffer, buffer_size, m_on_flush_state);
+    }
+    // without auto disable the buffer is kept up to date even while the
+    // sound is off. a borrowed buffer that isn't sent is left uncommitted
+    void* out = nullptr;
+    if(m_sound_enabled || (!m_auto_disable && acquired==nullptr)) {
+        out = output(audible,acquired);
+    }
+    if(first!=nullptr || ringing || m_limiter_delay!=nullptr) {
+        PLAYER_TIMING_RECORD(&m_render_timing,render_start,deadline);
+    }
+    m_clock+=m_frame_count;
+    if(out==nullptr || !m_sound_enabled) {
+        return;
+    }
+    PLAYER_TIMING_START(flush_start);
+    if(m_on_acquire_buffer_cb!=nullptr) {
+        if(m_on_commit_buffer_cb!=nullptr) {
+            m_on_commit_buffer_cb(out, buffer_size, m_on_commit_buffer_state);
         }
-    } else {
-        if(v==nullptr){
-            switch(m_bit_depth) {
-                case 8: {
-                    uint8_t* p = (uint8_t*)m_buffer;
-                    for(int i = 0;i<m_frame_count;++i) {
-                        for(int j = 0;j<m_channel_count;++j) {
-                            *p++=127;
-                        }
-                    }
-                }
-                break;
-                case 16: {
-                    uint16_t* p = (uint16_t*)m_buffer;
-                    for(int i = 0;i<m_frame_count;++i) {
-                        for(int j = 0;j<m_channel_count;++j) {
-                            *p++=32767;
-                        }
-                    }
-                }
-                break;
-            }
-
-        } else {
-            memset(m_buffer,0,buffer_size);
-            while(v!=nullptr) {
-                has_voices = true;
-                v->fn(vinf, v->fn_state);
-                v=v->next;
-            }
-        } 
-        
-        if(m_sound_enabled && m_on_flush_cb!=nullptr) {
-            m_on_flush_cb(m_buffer, buffer_size, m_on_flush_state);
+    } else if(m_on_flush_cb!=nullptr) {
+        m_on_flush_cb(out, buffer_size, m_on_flush_state);
+    }
+    PLAYER_TIMING_RECORD(&m_flush_timing,flush_start,deadline);
+}
+unsigned long long player::render(float seconds) {
+    if(m_buffer==nullptr || seconds<=0.0f || m_frame_count==0) {
+        return 0;
+    }
+    const unsigned long long frames = (unsigned long long)ceil((double)seconds*m_sample_rate);
+    const unsigned long long blocks = (frames+m_frame_count-1)/m_frame_count;
+    const unsigned long long start = m_clock;
+    for(unsigned long long i = 0;i<blocks;++i) {
+        update();
+    }
+    // blocks a full sink had no room for aren't rendered
+    return m_clock-start;
+}
+float player::deadline_tolerance() const {
+    return m_deadline_tolerance;
+}
+bool player::deadline_tolerance(float value) {
+    if(value<0.0f) {
+        return false;
+    }
+    m_deadline_tolerance = value;
+    return true;
+}
+bool player::limiter() const {
+    return m_limiter;
+}
+bool player::limiter(bool value) {
+    if(value==m_limiter) {
+        return true;
+    }
+    if(value && m_buffer!=nullptr) {
+        m_limiter_delay = (float*)player_aligned_alloc(m_frame_count*m_channel_count*sizeof(float),m_allocator);
+        if(m_limiter_delay==nullptr) {
+            return false;
         }
+    } else if(!value) {
+        player_aligned_free(m_limiter_delay,m_deallocator);
+        m_limiter_delay = nullptr;
+    }
+    m_limiter = value;
+    limiter_reset();
+    return true;
+}
+float player::limiter_threshold() const {
+    return m_limiter_threshold;
+}
+bool player::limiter_threshold(float value) {
+    if(!(value>0.0f && value<=1.0f)) {
+        return false;
+    }
+    m_limiter_threshold = value;
+    return true;
+}
+float player::limiter_release() const {
+    return m_limiter_release;
+}
+bool player::limiter_release(float value) {
+    if(!(value>0.0f)) {
+        return false;
     }
+    m_limiter_release = value;
+    return true;
+}
+float player::limiter_gain() const {
+    return m_limiter_gain;
+}
+unsigned long player::late_blocks() const {
+    return m_late_blocks;
+}
+unsigned long player::max_lateness() const {
+    return m_max_lateness;
+}
+unsigned long long player::total_lateness() const {
+    return m_total_lateness;
+}
+void player::reset_late_blocks() {
+    m_late_blocks = 0;
+    m_max_lateness = 0;
+    m_total_lateness = 0;
 }
 bool player::auto_disable() const {
     return m_auto_disable;
@@ -1131,4 +4819,38 @@ void player::sound_enabled(bool value) {
             m_sound_enabled = false;
         }
     }
-}
\ No newline at end of file
+}
+#ifdef PLAYER_INSTRUMENTATION
+const player_timing_t& player::render_timing() const {
+    return m_render_timing;
+}
+const player_timing_t& player::flush_timing() const {
+    return m_flush_timing;
+}
+bool player::voice_timing(voice_handle_t handle, player_timing_t* out_timing) const {
+    const voice_info_t* v = player_find_voice(m_first,handle);
+    if(v==nullptr || out_timing==nullptr) {
+        return false;
+    }
+    *out_timing = v->timing;
+    return true;
+}
+unsigned long player::block_deadline() const {
+    if(m_sample_rate==0) {
+        return 0;
+    }
+    return (unsigned long)(((unsigned long long)m_frame_count*player_ticks_per_second())/m_sample_rate);
+}
+unsigned long player::ticks_per_second() const {
+    return player_ticks_per_second();
+}
+void player::reset_timing() {
+    player_timing_reset(&m_render_timing);
+    player_timing_reset(&m_flush_timing);
+    voice_info_t* v = (voice_info_t*)m_first;
+    while(v!=nullptr) {
+        player_timing_reset(&v->timing);
+        v=v->next;
+    }
+}
+#endif
@@ -0,0 +1,196 @@
+#include <player_file_sink.hpp>
+#if __has_include(<Arduino.h>)
+#include <Arduino.h>
+#else
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+constexpr static const size_t player_wav_header_size = 44;
+
+static void player_put16(unsigned char*& p, uint16_t value) {
+    *p++=value&0xFF;
+    *p++=(value>>8)&0xFF;
+}
+static void player_put32(unsigned char*& p, uint32_t value) {
+    player_put16(p,value&0xFFFF);
+    player_put16(p,(value>>16)&0xFFFF);
+}
+player_file_sink::player_file_sink(size_t buffer_size, 
+                                void*(allocator)(size_t), 
+                                void(deallocator)(void*)) :
+                                    m_file(nullptr),
+                                    m_wav(false),
+                                    m_sample_rate(0),
+                                    m_channel_count(0),
+                                    m_bit_depth(0),
+                                    m_format(PLAYER_FORMAT_U16),
+                                    m_buffer(nullptr),
+                                    // whole 32-bit words so 16-bit samples never straddle a write
+                                    m_capacity(buffer_size&~(size_t)3),
+                                    m_buffered(0),
+                                    m_data_size(0),
+                                    m_error(false),
+                                    m_allocator(allocator),
+                                    m_deallocator(deallocator) {
+}
+player_file_sink::~player_file_sink() {
+    close();
+}
+bool player_file_sink::write_header() {
+    unsigned char header[player_wav_header_size];
+    unsigned char* p = header;
+    // wav sizes are 32-bit. clamp so oversized files at least stay readable
+    const uint32_t data_size = m_data_size>0xFFFFFFFFULL-36?(uint32_t)(0xFFFFFFFFULL-36):(uint32_t)m_data_size;
+    const unsigned int frame_size = m_channel_count*(m_bit_depth/8);
+    memcpy(p,"RIFF",4);p+=4;
+    player_put32(p,36+data_size);
+    memcpy(p,"WAVEfmt ",8);p+=8;
+    player_put32(p,16);
+    player_put16(p,m_format==PLAYER_FORMAT_F32?3:1); // IEEE float or PCM
+    player_put16(p,m_channel_count);
+    player_put32(p,m_sample_rate);
+    player_put32(p,m_sample_rate*frame_size);
+    player_put16(p,frame_size);
+    player_put16(p,m_bit_depth);
+    memcpy(p,"data",4);p+=4;
+    player_put32(p,data_size);
+    return sizeof(header)==fwrite(header,1,sizeof(header),m_file);
+}
+bool player_file_sink::open(const char* path, const player& source, bool wav) {
+    close();
+    if(path==nullptr || m_capacity==0) {
+        return false;
+    }
+    // a plain wav header can't describe 24 bits in a 32-bit container
+    if(wav && source.format()==PLAYER_FORMAT_S24_32) {
+        return false;
+    }
+    m_buffer = (unsigned char*)m_allocator(m_capacity);
+    if(m_buffer==nullptr) {
+        return false;
+    }
+    m_file = fopen(path,"wb");
+    if(m_file==nullptr) {
+        m_deallocator(m_buffer);
+        m_buffer = nullptr;
+        return false;
+    }
+    m_wav = wav;
+    m_sample_rate = source.sample_rate();
+    m_channel_count = source.channel_count();
+    m_bit_depth = source.bit_depth();
+    m_format = source.format();
+    m_buffered = 0;
+    m_data_size = 0;
+    m_error = false;
+    if(m_wav && !write_header()) {
+        close();
+        return false;
+    }
+    return true;
+}
+bool player_file_sink::is_open() const {
+    return m_file!=nullptr;
+}
+bool player_file_sink::flush_buffer() {
+    if(m_buffered!=0) {
+        if(m_buffered!=fwrite(m_buffer,1,m_buffered,m_file)) {
+            m_error = true;
+        }
+        m_buffered = 0;
+    }
+    return !m_error;
+}
+void player_file_sink::write(const void* buffer, size_t buffer_size) {
+    const unsigned char* src = (const unsigned char*)buffer;
+    m_data_size+=buffer_size;
+    while(buffer_size) {
+        if(m_buffered==m_capacity) {
+            flush_buffer();
+        }
+        size_t count = m_capacity-m_buffered;
+        if(count>buffer_size) {
+            count = buffer_size;
+        }
+        unsigned char* dst = m_buffer+m_buffered;
+        if(m_wav && m_format==PLAYER_FORMAT_U16) {
+            // the player produces unsigned 16-bit samples but wav wants signed,
+            // so flip the sign bit in the high byte of each sample as it's copied.
+            // blocks are always whole samples, and so are the buffered counts
+            for(size_t i = 0;i<count;i+=2) {
+                dst[i]=src[i];
+                dst[i+1]=src[i+1]^0x80;
+            }
+        } else {
+            memcpy(dst,src,count);
+        }
+        m_buffered+=count;
+        src+=count;
+        buffer_size-=count;
+    }
+}
+bool player_file_sink::close() {
+    if(m_file==nullptr) {
+        return false;
+    }
+    bool result = flush_buffer();
+    if(m_wav && result) {
+        result = 0==fseek(m_file,0,SEEK_SET) && write_header();
+    }
+    if(0!=fclose(m_file)) {
+        result = false;
+    }
+    m_file = nullptr;
+    m_deallocator(m_buffer);
+    m_buffer = nullptr;
+    return result;
+}
+void player_file_sink::attach(player& source) {
+    if(source.buffer_size()<=m_capacity) {
+        // the player renders straight into the write buffer
+        source.on_flush(nullptr);
+        source.on_acquire_buffer(on_acquire_buffer,this);
+        source.on_commit_buffer(on_commit_buffer,this);
+    } else {
+        source.on_acquire_buffer(nullptr);
+        source.on_commit_buffer(nullptr);
+        source.on_flush(on_flush,this);
+    }
+}
+unsigned long long player_file_sink::data_size() const {
+    return m_data_size;
+}
+bool player_file_sink::error() const {
+    return m_error;
+}
+void player_file_sink::on_flush(const void* buffer, size_t buffer_size, void* state) {
+    player_file_sink* sink = (player_file_sink*)state;
+    if(sink->m_file==nullptr) {
+        return;
+    }
+    sink->write(buffer,buffer_size);
+}
+void* player_file_sink::on_acquire_buffer(size_t buffer_size, void* state) {
+    player_file_sink* sink = (player_file_sink*)state;
+    if(sink->m_file==nullptr || buffer_size>sink->m_capacity) {
+        return nullptr;
+    }
+    if(sink->m_capacity-sink->m_buffered<buffer_size) {
+        sink->flush_buffer();
+    }
+    return sink->m_buffer+sink->m_buffered;
+}
+void player_file_sink::on_commit_buffer(void* buffer, size_t buffer_size, void* state) {
+    player_file_sink* sink = (player_file_sink*)state;
+    if(sink->m_wav && sink->m_format==PLAYER_FORMAT_U16) {
+        // see write()
+        unsigned char* p = (unsigned char*)buffer;
+        for(size_t i = 1;i<buffer_size;i+=2) {
+            p[i]^=0x80;
+        }
+    }
+    sink->m_buffered+=buffer_size;
+    sink->m_data_size+=buffer_size;
+}
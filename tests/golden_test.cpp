@@ -0,0 +1,625 @@
+// renders deterministic scenes through player::update() and compares the
+// flushed output against stored reference PCM within per format tolerances.
+// run with --generate to rewrite the references after an intended change.
+// the other output formats are checked against the unsigned 16-bit references.
+#include <player.hpp>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+constexpr static const unsigned int golden_sample_rate = 44100;
+constexpr static const size_t golden_frame_count = 128;
+constexpr static const size_t golden_blocks = 8;
+// the effects scene runs until its tail has died away
+constexpr static const size_t golden_effects_blocks = 384;
+
+typedef struct {
+    std::vector<uint8_t> data;
+    size_t pos;
+} golden_stream_t;
+
+static void golden_put16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value&0xFF);
+    out.push_back((value>>8)&0xFF);
+}
+static void golden_put32(std::vector<uint8_t>& out, uint32_t value) {
+    golden_put16(out,value&0xFFFF);
+    golden_put16(out,(value>>16)&0xFFFF);
+}
+// a 16-bit wav with a different deterministic tone on each channel
+static void golden_make_wav(golden_stream_t& stream, unsigned short channels, size_t frames) {
+    std::vector<uint8_t>& out = stream.data;
+    const uint32_t data_size = (uint32_t)(frames*channels*2);
+    out.clear();
+    out.insert(out.end(),{'R','I','F','F'});
+    golden_put32(out,36+data_size);
+    out.insert(out.end(),{'W','A','V','E','f','m','t',' '});
+    golden_put32(out,16);
+    golden_put16(out,1);
+    golden_put16(out,channels);
+    golden_put32(out,golden_sample_rate);
+    golden_put32(out,golden_sample_rate*channels*2);
+    golden_put16(out,channels*2);
+    golden_put16(out,16);
+    out.insert(out.end(),{'d','a','t','a'});
+    golden_put32(out,data_size);
+    for(size_t i = 0;i<frames;++i) {
+        for(unsigned short j = 0;j<channels;++j) {
+            // integer sawtooths so the source doesn't depend on libm
+            const int32_t period = 50+j*27;
+            const int32_t v = (int32_t)((i%period)*60000/period)-30000;
+            golden_put16(out,(uint16_t)(int16_t)v);
+        }
+    }
+    stream.pos = 0;
+}
+static void golden_put32_be(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((value>>24)&0xFF);
+    out.push_back((value>>16)&0xFF);
+    out.push_back((value>>8)&0xFF);
+    out.push_back(value&0xFF);
+}
+// a two track Standard MIDI File with notes on two channels and a tempo
+// change. truncated cuts the file off in the middle of the tempo change
+static void golden_make_midi(std::vector<uint8_t>& out, bool truncated) {
+    static const uint8_t conductor[] = {
+        0x00,0xFF,0x51,0x03,0x00,0xBB,0x80, // 48000us per quarter note
+        0x00,0xFF,0x2F,0x00
+    };
+    static const uint8_t notes[] = {
+        0x00,0xC0,0x50, // lead
+        0x00,0xC1,0x08, // chromatic percussion
+        0x00,0x90,0x3C,0x64,
+        0x08,0x91,0x43,0x50,
+        0x0C,0x80,0x3C,0x00,
+        0x00,0xB1,0x07,0x40,
+        0x06,0xFF,0x51,0x03,0x00,0x75,0x30, // 30000us per quarter note
+        0x04,0x90,0x40,0x64,
+        0x0A,0x81,0x43,0x00,
+        0x00,0xFF,0x2F,0x00
+    };
+    out.clear();
+    out.insert(out.end(),{'M','T','h','d'});
+    golden_put32_be(out,6);
+    out.insert(out.end(),{0x00,0x01,0x00,0x02,0x00,0x60});
+    out.insert(out.end(),{'M','T','r','k'});
+    golden_put32_be(out,sizeof(conductor));
+    out.insert(out.end(),conductor,conductor+sizeof(conductor));
+    out.insert(out.end(),{'M','T','r','k'});
+    golden_put32_be(out,sizeof(notes));
+    out.insert(out.end(),notes,notes+sizeof(notes));
+    if(truncated) {
+        // end after the first byte of the tempo
+        out.resize(out.size()-sizeof(notes)+27);
+    }
+}
+// sets a cell of a 4 channel MOD pattern
+static void golden_mod_cell(uint8_t* pattern, size_t row, size_t channel, uint8_t sample, uint16_t period, uint8_t effect, uint8_t param) {
+    uint8_t* cell = pattern+(row*4+channel)*4;
+    cell[0] = (sample&0xF0)|(period>>8);
+    cell[1] = period&0xFF;
+    cell[2] = ((sample&0x0F)<<4)|effect;
+    cell[3] = param;
+}
+// a one pattern module with a looped and a one shot sample. it speeds up
+// to a row every two ticks so a few rows fit in the scene. truncated cuts
+// the file off partway through the second sample
+static void golden_make_mod(std::vector<uint8_t>& out, bool truncated) {
+    const size_t header_size = 1084;
+    const size_t pattern_size = 64*4*4;
+    out.assign(header_size+pattern_size+32+64,0);
+    uint8_t* h = out.data()+20;
+    // 32 bytes at full volume, looped
+    h[23] = 16;
+    h[25] = 64;
+    h[29] = 16;
+    // 64 bytes at 48, not looped
+    h+=30;
+    h[23] = 32;
+    h[25] = 48;
+    h[29] = 1;
+    out[950] = 1;
+    memcpy(out.data()+1080,"M.K.",4);
+    uint8_t* pattern = out.data()+header_size;
+    golden_mod_cell(pattern,0,0,1,428,0x1,0x10); // portamento up
+    golden_mod_cell(pattern,0,1,2,214,0xC,0x20); // set volume
+    golden_mod_cell(pattern,0,2,0,0,0xF,0x02); // speed
+    golden_mod_cell(pattern,0,3,0,0,0xF,0xFF); // tempo
+    golden_mod_cell(pattern,1,0,1,320,0x0,0x00);
+    golden_mod_cell(pattern,1,1,0,0,0xA,0x02); // volume slide down
+    golden_mod_cell(pattern,2,1,2,254,0x0,0x00);
+    uint8_t* data = pattern+pattern_size;
+    for(size_t i = 0;i<32;++i) {
+        data[i] = (uint8_t)(int8_t)(i<16?90:-90);
+    }
+    data+=32;
+    for(size_t i = 0;i<64;++i) {
+        data[i] = (uint8_t)(int8_t)(i<32?i*4-64:192-i*4);
+    }
+    if(truncated) {
+        out.resize(out.size()-40);
+    }
+}
+static int golden_read(void* state) {
+    golden_stream_t* s = (golden_stream_t*)state;
+    if(s->pos>=s->data.size()) {
+        return -1;
+    }
+    return s->data[s->pos++];
+}
+static void golden_seek(unsigned long long pos, void* state) {
+    ((golden_stream_t*)state)->pos = (size_t)pos;
+}
+static void golden_flush(const void* buffer, size_t buffer_size, void* state) {
+    std::vector<uint8_t>* out = (std::vector<uint8_t>*)state;
+    out->insert(out->end(),(const uint8_t*)buffer,((const uint8_t*)buffer)+buffer_size);
+}
+// a custom voice producing a small ramp around the midpoint in the output format
+static void golden_custom_voice(const voice_function_info_t& info, void* state) {
+    unsigned int* step = (unsigned int*)state;
+    for(size_t i = 0;i<info.frame_count;++i) {
+        const unsigned int v = info.sample_max/2+((*step)++%64)*(info.sample_max/512);
+        for(unsigned int j = 0;j<info.channel_count;++j) {
+            switch(info.bit_depth) {
+                case 8:
+                    ((uint8_t*)info.buffer)[i*info.channel_count+j]+=(uint8_t)v;
+                    break;
+                case 16:
+                    ((uint16_t*)info.buffer)[i*info.channel_count+j]+=(uint16_t)v;
+                    break;
+            }
+        }
+    }
+}
+
+typedef enum {
+    GOLDEN_SIN = 0,
+    GOLDEN_SQR,
+    GOLDEN_SAW,
+    GOLDEN_TRI,
+    GOLDEN_WAV_MONO,
+    GOLDEN_WAV_STEREO,
+    GOLDEN_MIX,
+    GOLDEN_MIDI,
+    GOLDEN_MIDI_TRUNCATED,
+    GOLDEN_MOD,
+    GOLDEN_MOD_TRUNCATED,
+    GOLDEN_SCHEDULED,
+    GOLDEN_LIMITER,
+    GOLDEN_FILTERS,
+    GOLDEN_EFFECTS,
+    GOLDEN_SEQUENCE,
+    GOLDEN_FM,
+    GOLDEN_NOISE_WHITE,
+    GOLDEN_NOISE_PINK,
+    GOLDEN_NOISE_BROWN,
+    GOLDEN_SCENE_COUNT
+} golden_scene_t;
+static const char* golden_scene_names[] = {
+    "sin","sqr","saw","tri","wav_mono","wav_stereo","mix","midi","midi_truncated",
+    "mod","mod_truncated","scheduled","limiter","filters","effects","sequence","fm","noise_white","noise_pink","noise_brown"
+};
+
+static bool golden_expect(const char* what, bool found, unsigned long long actual, unsigned long long expected) {
+    if(!found) {
+        printf("FAIL %s: not available, %llu expected\n",what,expected);
+        return false;
+    }
+    if(actual!=expected) {
+        printf("FAIL %s: %llu, %llu expected\n",what,actual,expected);
+        return false;
+    }
+    return true;
+}
+static bool golden_expect_position(const player& p, voice_handle_t handle, const char* what, unsigned long long expected) {
+    unsigned long long value = 0;
+    const bool found = p.position(handle,&value);
+    return golden_expect(what,found,value,expected);
+}
+static bool golden_expect_remaining(const player& p, voice_handle_t handle, const char* what, unsigned long long expected) {
+    unsigned long long value = 0;
+    const bool found = p.remaining(handle,&value);
+    return golden_expect(what,found,value,expected);
+}
+// checks the clock and the voices' positions against where the schedule
+// puts them, before the block starting at the current clock is rendered
+static bool golden_check_schedule(const player& p, voice_handle_t sin, voice_handle_t wav, voice_handle_t tri) {
+    unsigned long long value = 0;
+    bool result = true;
+    switch(p.frame_clock()) {
+        case 0:
+            // a voice that hasn't started has its whole schedule left
+            result&=golden_expect_position(p,sin,"sin position",0);
+            result&=golden_expect_remaining(p,sin,"sin remaining",400);
+            result&=golden_expect_remaining(p,wav,"wav remaining",700);
+            result&=golden_expect_remaining(p,tri,"tri remaining",450);
+            break;
+        case golden_frame_count*3:
+            result&=golden_expect_position(p,sin,"sin position",84);
+            result&=golden_expect_remaining(p,sin,"sin remaining",316);
+            result&=golden_expect_position(p,wav,"wav position",254);
+            result&=golden_expect_remaining(p,wav,"wav remaining",446);
+            result&=golden_expect_remaining(p,tri,"tri remaining",66);
+            break;
+        case golden_frame_count*6:
+            // the stopped voices are gone
+            result&=!p.remaining(sin,&value) && !p.remaining(tri,&value);
+            result&=golden_expect_position(p,wav,"wav position",638);
+            break;
+        default:
+            break;
+    }
+    return result;
+}
+
+// steps start partway through blocks, notes overlap, the fourth finds
+// every voice busy and is dropped, and the sequence loops inside the scene
+static const player_note_t golden_notes[] = {
+    {0,4,60,PLAYER_WAVEFORM_SIN,120},
+    {1,3,67,PLAYER_WAVEFORM_SQR,60},
+    {2,1,72,PLAYER_WAVEFORM_SAW,80},
+    {2,2,76,PLAYER_WAVEFORM_TRI,180},
+    {5,1,64,PLAYER_WAVEFORM_TRI,200},
+    {7,3,55,PLAYER_WAVEFORM_SAW,90}
+};
+// a carrier and two modulators, each with an envelope short enough
+// to run through every stage inside the scene
+static const player_fm_operator_t golden_operators[] = {
+    {1.0f,1.0f,.002f,.006f,.7f,.004f},
+    {2.0f,2.5f,.001f,.004f,.4f,.003f},
+    {3.5f,1.2f,.003f,.002f,.6f,.002f}
+};
+static bool golden_render(golden_scene_t scene, 
+                        unsigned short channels, 
+                        player_format_t format, 
+                        std::vector<uint8_t>& out) {
+    player p(golden_sample_rate,channels,format,golden_frame_count);
+    p.on_flush(golden_flush,&out);
+    if(!p.initialize()) {
+        return false;
+    }
+    golden_stream_t mono, stereo;
+    golden_make_wav(mono,1,700);
+    golden_make_wav(stereo,2,700);
+    std::vector<uint8_t> file;
+    voice_handle_t h = nullptr;
+    voice_handle_t scheduled_wav = nullptr, scheduled_tri = nullptr;
+    voice_handle_t dry = nullptr;
+    // scenes that don't play a voice of their own
+    bool started = false;
+    switch(scene) {
+        case GOLDEN_SIN:
+            h = p.sin(0,441.0f,.7f);
+            break;
+        case GOLDEN_SQR:
+            h = p.sqr(0,300.0f,.7f);
+            break;
+        case GOLDEN_SAW:
+            h = p.saw(0,300.0f,.7f);
+            break;
+        case GOLDEN_TRI:
+            h = p.tri(0,300.0f,.7f);
+            break;
+        case GOLDEN_WAV_MONO:
+            h = p.wav(0,golden_read,&mono,.8f,true,golden_seek,&mono);
+            break;
+        case GOLDEN_WAV_STEREO:
+            h = p.wav(0,golden_read,&stereo,.8f,false,golden_seek,&stereo);
+            break;
+        case GOLDEN_MIX: {
+            h = p.sin(0,220.0f,.3f);
+            voice_handle_t s = p.sqr(1,550.0f,.2f);
+            voice_handle_t w = p.wav(2,golden_read,&mono,.4f,false,golden_seek,&mono);
+            unsigned int* step = p.allocate_voice_state<unsigned int>();
+            if(step==nullptr) {
+                return false;
+            }
+            *step = 0;
+            if(s==nullptr || w==nullptr || nullptr==p.voice(3,golden_custom_voice,step)) {
+                return false;
+            }
+            p.pan(h,-.5f);
+            p.pan(s,.75f);
+            p.port_gain(1,.5f);
+            p.envelope(w,.002f,.003f,.6f,.004f);
+        }
+        break;
+        case GOLDEN_MIDI:
+        case GOLDEN_MIDI_TRUNCATED:
+            golden_make_midi(file,scene==GOLDEN_MIDI_TRUNCATED);
+            started = p.midi(0,file.data(),file.size(),.6f,false,4);
+            break;
+        case GOLDEN_MOD:
+        case GOLDEN_MOD_TRUNCATED:
+            golden_make_mod(file,scene==GOLDEN_MOD_TRUNCATED);
+            // a module cut off inside its patterns can't play at all
+            if(scene==GOLDEN_MOD_TRUNCATED && p.mod(1,file.data(),1100)) {
+                return false;
+            }
+            started = p.mod(0,file.data(),file.size(),.6f,false);
+            break;
+        case GOLDEN_SCHEDULED:
+            // starts and stops that fall partway through blocks
+            h = p.sin(0,441.0f,.7f);
+            scheduled_wav = p.wav(1,golden_read,&mono,.6f,false,golden_seek,&mono);
+            scheduled_tri = p.tri(2,300.0f,.5f);
+            if(scheduled_wav==nullptr || scheduled_tri==nullptr ||
+                !p.start_at(h,300) || !p.stop_at(h,700) ||
+                !p.start_at(scheduled_wav,130) || !p.stop_at(scheduled_tri,450)) {
+                return false;
+            }
+            break;
+        case GOLDEN_LIMITER: {
+            // well over full scale, so the limiter has to pull it down
+            h = p.sin(0,441.0f,.9f);
+            voice_handle_t s = p.sqr(1,300.0f,.9f);
+            voice_handle_t w = p.saw(2,200.0f,.8f);
+            if(s==nullptr || w==nullptr || !p.limiter(true) ||
+                !p.limiter_threshold(.7f) || !p.limiter_release(.005f)) {
+                return false;
+            }
+        }
+        break;
+        case GOLDEN_FILTERS: {
+            // a filter chain on a voice, on a port, and on the final mix
+            h = p.saw(0,300.0f,.25f);
+            voice_handle_t s = p.sqr(1,550.0f,.2f);
+            voice_handle_t w = p.wav(1,golden_read,&mono,.2f,true,golden_seek,&mono);
+            if(s==nullptr || w==nullptr ||
+                !p.filter(h,0,PLAYER_FILTER_LOWPASS,1200.0f,1.5f) ||
+                !p.filter(h,1,PLAYER_FILTER_PEAK,600.0f,2.0f,6.0f) ||
+                !p.port_filter(1,0,PLAYER_FILTER_HIGHPASS,400.0f) ||
+                !p.port_filter(1,2,PLAYER_FILTER_BANDPASS,2000.0f,.8f) ||
+                !p.master_filter(0,PLAYER_FILTER_LOWSHELF,200.0f,.7071f,-4.0f) ||
+                !p.master_filter(1,PLAYER_FILTER_HIGHSHELF,5000.0f,.7071f,3.0f)) {
+                return false;
+            }
+        }
+        break;
+        case GOLDEN_EFFECTS:
+            // one port sends to the delay and reverb, the other stays dry
+            h = p.sin(1,441.0f,.2f);
+            dry = p.sqr(0,300.0f,.2f);
+            if(dry==nullptr || !p.port_send(1,.5f) ||
+                !p.send_delay(.004f,.3f,.5f) || !p.send_reverb(.1f,.8f,.4f)) {
+                return false;
+            }
+            break;
+        case GOLDEN_SEQUENCE:
+            started = p.sequence(0,golden_notes,sizeof(golden_notes)/sizeof(golden_notes[0]),10,.002f,true,3);
+            break;
+        case GOLDEN_FM:
+            h = p.fm(0,220.0f,golden_operators,sizeof(golden_operators)/sizeof(golden_operators[0]),.6f);
+            break;
+        case GOLDEN_NOISE_WHITE:
+            h = p.noise(0,PLAYER_NOISE_WHITE,.5f);
+            break;
+        case GOLDEN_NOISE_PINK:
+            h = p.noise(0,PLAYER_NOISE_PINK,.5f);
+            break;
+        case GOLDEN_NOISE_BROWN:
+            h = p.noise(0,PLAYER_NOISE_BROWN,.5f);
+            break;
+        default:
+            break;
+    }
+    if(h==nullptr && !started) {
+        return false;
+    }
+    const size_t blocks = scene==GOLDEN_EFFECTS?golden_effects_blocks:golden_blocks;
+    for(size_t i = 0;i<blocks;++i) {
+        if(scene==GOLDEN_MIX && i==3) {
+            p.amplitude(h,.5f);
+            p.frequency(h,330.0f);
+            p.port_mute(3,true);
+        }
+        if(scene==GOLDEN_LIMITER && i==5) {
+            // the release lets the gain back up once it gets quieter
+            p.amplitude(h,.1f);
+            p.stop_port(1);
+        }
+        if(scene==GOLDEN_FILTERS && i==4) {
+            // retuning keeps the filter state, and a stage can be turned off
+            p.filter(h,0,PLAYER_FILTER_LOWPASS,2500.0f,.9f);
+            p.port_filter(1,2,PLAYER_FILTER_NONE);
+        }
+        if(scene==GOLDEN_FM && i==4) {
+            // the voice ends once the carrier's release does
+            p.release(h);
+        }
+        if(scene==GOLDEN_EFFECTS && i==4) {
+            // the send stops, and the tail rings on after the voices end
+            p.port_send(1,0.0f);
+        }
+        if(scene==GOLDEN_EFFECTS && i==6) {
+            p.stop(h);
+            p.stop(dry);
+        }
+        if(scene==GOLDEN_SCHEDULED) {
+            if(p.frame_clock()!=i*golden_frame_count) {
+                printf("FAIL frame clock: %llu, %llu expected\n",p.frame_clock(),(unsigned long long)(i*golden_frame_count));
+                return false;
+            }
+            if(!golden_check_schedule(p,h,scheduled_wav,scheduled_tri)) {
+                return false;
+            }
+        }
+        p.update();
+    }
+    if(scene==GOLDEN_EFFECTS && p.sound_enabled()) {
+        printf("FAIL effects: the tail never went idle\n");
+        return false;
+    }
+    if(scene==GOLDEN_LIMITER && !(p.limiter_gain()<1.0f)) {
+        printf("FAIL limiter gain: %f, under 1 expected\n",p.limiter_gain());
+        return false;
+    }
+    return true;
+}
+static void golden_path(char* out, size_t size, const char* dir, golden_scene_t scene, unsigned short channels, unsigned short bit_depth) {
+    snprintf(out,size,"%s/%s_%u_%u.pcm",dir,golden_scene_names[scene],channels,bit_depth);
+}
+static bool golden_load(const char* path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path,"rb");
+    if(f==nullptr) {
+        return false;
+    }
+    uint8_t buf[4096];
+    size_t read;
+    while(0<(read=fread(buf,1,sizeof(buf),f))) {
+        out.insert(out.end(),buf,buf+read);
+    }
+    fclose(f);
+    return true;
+}
+static bool golden_save(const char* path, const std::vector<uint8_t>& data) {
+    FILE* f = fopen(path,"wb");
+    if(f==nullptr) {
+        return false;
+    }
+    bool result = data.size()==fwrite(data.data(),1,data.size(),f);
+    fclose(f);
+    return result;
+}
+// converts output in another format to unsigned 16-bit for comparison
+static void golden_to_u16(const std::vector<uint8_t>& in, player_format_t format, std::vector<uint8_t>& out) {
+    out.clear();
+    const size_t bytes = format==PLAYER_FORMAT_S16?2:4;
+    for(size_t i = 0;i+bytes<=in.size();i+=bytes) {
+        int64_t v;
+        if(format==PLAYER_FORMAT_F32) {
+            float f;
+            memcpy(&f,in.data()+i,sizeof(f));
+            v = (int64_t)(f*32768.0f+32768.5f);
+        } else if(format==PLAYER_FORMAT_S16) {
+            int16_t s16;
+            memcpy(&s16,in.data()+i,sizeof(s16));
+            v = s16+32768;
+        } else {
+            int32_t s32;
+            memcpy(&s32,in.data()+i,sizeof(s32));
+            if(format==PLAYER_FORMAT_S24_32) {
+                v = (s32+8388608LL+128)>>8;
+            } else {
+                v = (s32+2147483648LL+32768)>>16;
+            }
+        }
+        v = v<0?0:v>65535?65535:v;
+        golden_put16(out,(uint16_t)v);
+    }
+}
+// compares as unsigned samples of the output bit depth
+static bool golden_compare(const char* name, 
+                        const std::vector<uint8_t>& actual, 
+                        const std::vector<uint8_t>& expected, 
+                        unsigned short bit_depth) {
+    if(actual.size()!=expected.size()) {
+        printf("FAIL %s: %zu bytes rendered, %zu expected\n",name,actual.size(),expected.size());
+        return false;
+    }
+    // float rounding may differ between compilers and vectorized kernels
+    const int tolerance = bit_depth==8?1:2;
+    const size_t bytes = bit_depth/8;
+    size_t failures = 0;
+    size_t first = 0;
+    int max_diff = 0;
+    for(size_t i = 0;i<actual.size();i+=bytes) {
+        int a = actual[i], e = expected[i];
+        if(bytes==2) {
+            a|=actual[i+1]<<8;
+            e|=expected[i+1]<<8;
+        }
+        const int diff = abs(a-e);
+        if(diff>tolerance) {
+            if(failures++==0) {
+                first = i/bytes;
+            }
+        }
+        if(diff>max_diff) {
+            max_diff = diff;
+        }
+    }
+    if(failures) {
+        printf("FAIL %s: %zu samples out of tolerance, first at %zu, max diff %d\n",name,failures,first,max_diff);
+        return false;
+    }
+    printf("ok   %s (max diff %d)\n",name,max_diff);
+    return true;
+}
+int main(int argc, char** argv) {
+    const char* dir = nullptr;
+    bool generate = false;
+    for(int i = 1;i<argc;++i) {
+        if(0==strcmp(argv[i],"--generate")) {
+            generate = true;
+        } else {
+            dir = argv[i];
+        }
+    }
+    if(dir==nullptr) {
+        fprintf(stderr,"usage: %s [--generate] <reference directory>\n",argv[0]);
+        return 2;
+    }
+    static const unsigned short formats[][2] = {{1,8},{2,8},{1,16},{2,16}};
+    int result = 0;
+    for(int s = GOLDEN_SIN;s<GOLDEN_SCENE_COUNT;++s) {
+        for(size_t f = 0;f<sizeof(formats)/sizeof(formats[0]);++f) {
+            const unsigned short channels = formats[f][0];
+            const unsigned short bit_depth = formats[f][1];
+            char path[1024];
+            golden_path(path,sizeof(path),dir,(golden_scene_t)s,channels,bit_depth);
+            const char* name = strrchr(path,'/')+1;
+            std::vector<uint8_t> actual;
+            const player_format_t format = bit_depth==8?PLAYER_FORMAT_U8:PLAYER_FORMAT_U16;
+            if(!golden_render((golden_scene_t)s,channels,format,actual)) {
+                printf("FAIL %s: could not render the scene\n",name);
+                result = 1;
+                continue;
+            }
+            if(generate) {
+                if(!golden_save(path,actual)) {
+                    printf("FAIL %s: could not write the reference\n",name);
+                    result = 1;
+                } else {
+                    printf("wrote %s\n",name);
+                }
+                continue;
+            }
+            std::vector<uint8_t> expected;
+            if(!golden_load(path,expected)) {
+                printf("FAIL %s: missing reference\n",name);
+                result = 1;
+                continue;
+            }
+            if(!golden_compare(name,actual,expected,bit_depth)) {
+                result = 1;
+            }
+            if(bit_depth!=16) {
+                continue;
+            }
+            static const player_format_t other_formats[] = {
+                PLAYER_FORMAT_S16,PLAYER_FORMAT_S24_32,PLAYER_FORMAT_S32,PLAYER_FORMAT_F32
+            };
+            static const char* other_format_names[] = {
+                "s16","s24_32","s32","f32"
+            };
+            for(size_t o = 0;o<sizeof(other_formats)/sizeof(other_formats[0]);++o) {
+                char other_name[1024];
+                snprintf(other_name,sizeof(other_name),"%s as %s",name,other_format_names[o]);
+                std::vector<uint8_t> other, converted;
+                if(!golden_render((golden_scene_t)s,channels,other_formats[o],other)) {
+                    printf("FAIL %s: could not render the scene\n",other_name);
+                    result = 1;
+                    continue;
+                }
+                golden_to_u16(other,other_formats[o],converted);
+                if(!golden_compare(other_name,converted,expected,16)) {
+                    result = 1;
+                }
+            }
+        }
+    }
+    return result;
+}
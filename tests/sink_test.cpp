@@ -0,0 +1,337 @@
+// renders the same scene through each of the player's output paths and
+// checks that every one of them produces exactly what on_flush does.
+#include <player_file_sink.hpp>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+constexpr static const unsigned int sink_sample_rate = 44100;
+constexpr static const size_t sink_frame_count = 128;
+constexpr static const size_t sink_blocks = 8;
+constexpr static const char* sink_path = "player_sink_test.tmp";
+
+static void sink_flush(const void* buffer, size_t buffer_size, void* state) {
+    std::vector<uint8_t>& out = *(std::vector<uint8_t>*)state;
+    const uint8_t* p = (const uint8_t*)buffer;
+    out.insert(out.end(),p,p+buffer_size);
+}
+// a voice on each of two ports, one of which stops partway through a block
+static bool sink_scene(player& p) {
+    voice_handle_t s = p.sin(0,441.0f,.5f);
+    voice_handle_t w = p.saw(1,300.0f,.3f);
+    return s!=nullptr && w!=nullptr && p.pan(w,.4f) && p.stop_at(w,700);
+}
+// renders the scene into out through on_flush, the reference for the others
+static bool sink_reference(unsigned short channels, player_format_t format, std::vector<uint8_t>& out) {
+    player p(sink_sample_rate,channels,format,sink_frame_count);
+    p.on_flush(sink_flush,&out);
+    if(!p.initialize() || !sink_scene(p)) {
+        return false;
+    }
+    for(size_t i = 0;i<sink_blocks;++i) {
+        p.update();
+    }
+    return true;
+}
+// the first PLAYER_BUFFER_ALIGNMENT aligned byte of the storage
+static uint8_t* sink_align(std::vector<uint8_t>& storage) {
+    const uintptr_t misalignment = (uintptr_t)storage.data()&(PLAYER_BUFFER_ALIGNMENT-1);
+    return storage.data()+(misalignment==0?0:PLAYER_BUFFER_ALIGNMENT-misalignment);
+}
+static bool sink_load(const char* path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path,"rb");
+    if(f==nullptr) {
+        return false;
+    }
+    uint8_t tmp[4096];
+    size_t read;
+    out.clear();
+    while(0<(read = fread(tmp,1,sizeof(tmp),f))) {
+        out.insert(out.end(),tmp,tmp+read);
+    }
+    fclose(f);
+    return true;
+}
+static uint32_t sink_get16(const std::vector<uint8_t>& data, size_t offset) {
+    return data[offset]|(data[offset+1]<<8);
+}
+static uint32_t sink_get32(const std::vector<uint8_t>& data, size_t offset) {
+    return sink_get16(data,offset)|(sink_get16(data,offset+2)<<16);
+}
+// compares rendered PCM with the reference. wav files hold signed 16-bit
+// samples, so unsigned 16-bit output has had its sign bit flipped on the way
+static bool sink_compare(const char* what,
+                        const uint8_t* actual,
+                        size_t actual_size,
+                        const std::vector<uint8_t>& expected,
+                        bool flipped) {
+    if(actual_size!=expected.size()) {
+        printf("FAIL %s: %d bytes, expected %d\n",what,(int)actual_size,(int)expected.size());
+        return false;
+    }
+    for(size_t i = 0;i<actual_size;++i) {
+        const uint8_t e = expected[i]^((flipped && (i&1))?0x80:0x00);
+        if(actual[i]!=e) {
+            printf("FAIL %s: byte %d is %d, expected %d\n",what,(int)i,(int)actual[i],(int)e);
+            return false;
+        }
+    }
+    return true;
+}
+// checks the header close() rewrote with the final sizes
+static bool sink_check_header(const char* what,
+                            const std::vector<uint8_t>& file,
+                            unsigned short channels,
+                            player_format_t format,
+                            size_t data_size) {
+    const unsigned short bits = format==PLAYER_FORMAT_U8?8:format==PLAYER_FORMAT_F32?32:16;
+    if(file.size()<44 || 0!=memcmp(file.data(),"RIFF",4) || 0!=memcmp(file.data()+8,"WAVEfmt ",8) ||
+        0!=memcmp(file.data()+36,"data",4)) {
+        printf("FAIL %s: not a wav file\n",what);
+        return false;
+    }
+    if(sink_get32(file,4)!=36+data_size || sink_get32(file,40)!=data_size) {
+        printf("FAIL %s: the header holds %d data bytes, expected %d\n",what,(int)sink_get32(file,40),(int)data_size);
+        return false;
+    }
+    if(sink_get16(file,20)!=(format==PLAYER_FORMAT_F32?3U:1U) || sink_get16(file,22)!=channels ||
+        sink_get32(file,24)!=sink_sample_rate || sink_get16(file,34)!=bits) {
+        printf("FAIL %s: the header doesn't describe the output\n",what);
+        return false;
+    }
+    return true;
+}
+// renders the scene offline into a file through the sink. a small write
+// buffer makes the sink fall back to on_flush and split blocks across writes
+static bool sink_test_file(const char* what,
+                        unsigned short channels,
+                        player_format_t format,
+                        size_t capacity,
+                        bool wav,
+                        const std::vector<uint8_t>& expected) {
+    player p(sink_sample_rate,channels,format,sink_frame_count);
+    player_file_sink sink(capacity);
+    if(!p.initialize() || !sink.open(sink_path,p,wav)) {
+        printf("FAIL %s: could not open the sink\n",what);
+        return false;
+    }
+    sink.attach(p);
+    if(!sink_scene(p)) {
+        printf("FAIL %s: could not start the scene\n",what);
+        return false;
+    }
+    // a little under the scene, which render() rounds up to whole blocks
+    const float seconds = (sink_blocks*sink_frame_count-.5f)/sink_sample_rate;
+    const unsigned long long frames = p.render(seconds);
+    if(frames!=sink_blocks*sink_frame_count) {
+        printf("FAIL %s: rendered %d frames, expected %d\n",what,(int)frames,(int)(sink_blocks*sink_frame_count));
+        return false;
+    }
+    if(sink.data_size()!=expected.size() || !sink.close() || sink.error()) {
+        printf("FAIL %s: the sink didn't write the whole scene\n",what);
+        return false;
+    }
+    std::vector<uint8_t> file;
+    const bool loaded = sink_load(sink_path,file);
+    remove(sink_path);
+    if(!loaded) {
+        printf("FAIL %s: could not read the file back\n",what);
+        return false;
+    }
+    if(!wav) {
+        return sink_compare(what,file.data(),file.size(),expected,false);
+    }
+    if(!sink_check_header(what,file,channels,format,expected.size())) {
+        return false;
+    }
+    return sink_compare(what,file.data()+44,file.size()-44,expected,format==PLAYER_FORMAT_U16);
+}
+typedef struct {
+    std::vector<uint8_t>* out;
+    const void* buffer;
+    bool wrong_buffer;
+} sink_external_t;
+static void sink_external_flush(const void* buffer, size_t buffer_size, void* state) {
+    sink_external_t* ext = (sink_external_t*)state;
+    if(buffer!=ext->buffer) {
+        ext->wrong_buffer = true;
+    }
+    sink_flush(buffer,buffer_size,ext->out);
+}
+// renders the scene into storage the caller owns instead of the player's
+static bool sink_test_external(const char* what,
+                            unsigned short channels,
+                            player_format_t format,
+                            const std::vector<uint8_t>& expected) {
+    player p(sink_sample_rate,channels,format,sink_frame_count);
+    if(!p.initialize()) {
+        printf("FAIL %s: could not initialize the player\n",what);
+        return false;
+    }
+    const size_t size = p.buffer_size();
+    std::vector<uint8_t> storage(size+PLAYER_BUFFER_ALIGNMENT);
+    uint8_t* aligned = sink_align(storage);
+    // misaligned or undersized storage is refused
+    if(p.buffer(aligned+1,size) || p.buffer(aligned,size-1)) {
+        printf("FAIL %s: took a buffer it can't use\n",what);
+        return false;
+    }
+    if(!p.buffer(aligned,size) || p.buffer()!=aligned) {
+        printf("FAIL %s: didn't take the buffer\n",what);
+        return false;
+    }
+    std::vector<uint8_t> actual;
+    sink_external_t ext;
+    ext.out = &actual;
+    ext.buffer = aligned;
+    ext.wrong_buffer = false;
+    p.on_flush(sink_external_flush,&ext);
+    if(!sink_scene(p)) {
+        printf("FAIL %s: could not start the scene\n",what);
+        return false;
+    }
+    for(size_t i = 0;i<sink_blocks;++i) {
+        p.update();
+    }
+    if(ext.wrong_buffer) {
+        printf("FAIL %s: flushed a buffer other than the caller's\n",what);
+        return false;
+    }
+    if(!sink_compare(what,actual.data(),actual.size(),expected,false)) {
+        return false;
+    }
+    // and back to a buffer of its own
+    if(!p.buffer(nullptr,0) || p.buffer()==nullptr || p.buffer()==aligned) {
+        printf("FAIL %s: didn't go back to its own buffer\n",what);
+        return false;
+    }
+    return true;
+}
+// a sink that lends two buffers in turn and refuses one acquire, as if
+// the output were full
+typedef struct {
+    std::vector<uint8_t>* out;
+    uint8_t* buffers[2];
+    size_t size;
+    size_t acquired;
+    size_t refuse;
+    void* lent;
+    bool bad_commit;
+    bool flushed;
+} sink_lend_t;
+static void* sink_lend_acquire(size_t buffer_size, void* state) {
+    sink_lend_t* lend = (sink_lend_t*)state;
+    if(buffer_size!=lend->size || lend->acquired++==lend->refuse) {
+        return nullptr;
+    }
+    lend->lent = lend->buffers[lend->acquired&1];
+    return lend->lent;
+}
+static void sink_lend_commit(void* buffer, size_t buffer_size, void* state) {
+    sink_lend_t* lend = (sink_lend_t*)state;
+    if(buffer!=lend->lent || buffer_size!=lend->size) {
+        lend->bad_commit = true;
+    }
+    lend->lent = nullptr;
+    sink_flush(buffer,buffer_size,lend->out);
+}
+static void sink_lend_flush(const void* buffer, size_t buffer_size, void* state) {
+    (void)buffer;
+    (void)buffer_size;
+    ((sink_lend_t*)state)->flushed = true;
+}
+// renders the scene straight into buffers the sink lends through acquire
+// and hands back through commit, instead of flushing a copy
+static bool sink_test_lend(const char* what,
+                        unsigned short channels,
+                        player_format_t format,
+                        const std::vector<uint8_t>& expected) {
+    player p(sink_sample_rate,channels,format,sink_frame_count);
+    if(!p.initialize()) {
+        printf("FAIL %s: could not initialize the player\n",what);
+        return false;
+    }
+    const size_t size = p.buffer_size();
+    std::vector<uint8_t> storage(size*2+PLAYER_BUFFER_ALIGNMENT);
+    std::vector<uint8_t> actual;
+    sink_lend_t lend;
+    lend.out = &actual;
+    lend.buffers[0] = sink_align(storage);
+    lend.buffers[1] = lend.buffers[0]+size;
+    lend.size = size;
+    lend.acquired = 0;
+    lend.refuse = 3;
+    lend.lent = nullptr;
+    lend.bad_commit = false;
+    lend.flushed = false;
+    // on_flush is passed over while acquire is set
+    p.on_flush(sink_lend_flush,&lend);
+    p.on_acquire_buffer(sink_lend_acquire,&lend);
+    p.on_commit_buffer(sink_lend_commit,&lend);
+    if(!sink_scene(p)) {
+        printf("FAIL %s: could not start the scene\n",what);
+        return false;
+    }
+    // one more update than blocks, for the one with nowhere to go
+    for(size_t i = 0;i<=sink_blocks;++i) {
+        const unsigned long long clock = p.frame_clock();
+        p.update();
+        if(i==lend.refuse && p.frame_clock()!=clock) {
+            printf("FAIL %s: rendered a block with nowhere to put it\n",what);
+            return false;
+        }
+    }
+    if(lend.acquired<=lend.refuse || lend.bad_commit || lend.flushed) {
+        printf("FAIL %s: a block didn't go back through commit\n",what);
+        return false;
+    }
+    return sink_compare(what,actual.data(),actual.size(),expected,false);
+}
+int main() {
+    static const struct {
+        unsigned short channels;
+        player_format_t format;
+        const char* name;
+    } formats[] = {
+        {1,PLAYER_FORMAT_U8,"mono u8"},
+        {2,PLAYER_FORMAT_U8,"stereo u8"},
+        {1,PLAYER_FORMAT_U16,"mono u16"},
+        {2,PLAYER_FORMAT_U16,"stereo u16"},
+        {2,PLAYER_FORMAT_S16,"stereo s16"},
+        {2,PLAYER_FORMAT_F32,"stereo f32"}
+    };
+    int result = 0;
+    for(size_t f = 0;f<sizeof(formats)/sizeof(formats[0]);++f) {
+        const char* name = formats[f].name;
+        std::vector<uint8_t> expected;
+        if(!sink_reference(formats[f].channels,formats[f].format,expected)) {
+            printf("FAIL %s: could not render the scene\n",name);
+            result = 1;
+            continue;
+        }
+        char what[256];
+        snprintf(what,sizeof(what),"%s wav",name);
+        if(!sink_test_file(what,formats[f].channels,formats[f].format,64*1024,true,expected)) {
+            result = 1;
+        }
+        snprintf(what,sizeof(what),"%s wav through on_flush",name);
+        if(!sink_test_file(what,formats[f].channels,formats[f].format,100,true,expected)) {
+            result = 1;
+        }
+        snprintf(what,sizeof(what),"%s raw",name);
+        if(!sink_test_file(what,formats[f].channels,formats[f].format,64*1024,false,expected)) {
+            result = 1;
+        }
+        snprintf(what,sizeof(what),"%s into a caller's buffer",name);
+        if(!sink_test_external(what,formats[f].channels,formats[f].format,expected)) {
+            result = 1;
+        }
+        snprintf(what,sizeof(what),"%s through acquire and commit",name);
+        if(!sink_test_lend(what,formats[f].channels,formats[f].format,expected)) {
+            result = 1;
+        }
+    }
+    return result;
+}